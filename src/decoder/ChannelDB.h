@@ -0,0 +1,111 @@
+#pragma once
+
+//
+// Per-channel values addressed by crate, slot and channel, with the file reading and writing of the databases
+// (PedestalDB, PulseTemplateDB)
+//
+// File format, one channel per line, "#" starts a comment:
+// crate  slot  channel  values of the database...
+//
+
+#include "Fadc250Data.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+
+namespace fdec
+{
+
+template<class T>
+class ChannelDB
+{
+public:
+    void Set(uint32_t crate, uint32_t slot, uint32_t channel, const T &val)
+    {
+        _vals[Key(crate, slot, channel)] = val;
+    }
+
+    // nullptr if the channel is not in the database
+    const T *Get(uint32_t crate, uint32_t slot, uint32_t channel) const
+    {
+        auto it = _vals.find(Key(crate, slot, channel));
+        return (it == _vals.end()) ? nullptr : &it->second;
+    }
+
+    size_t Size() const { return _vals.size(); }
+    void Clear() { _vals.clear(); }
+
+    // slot and channel fit in 5 and 4 bits
+    static uint32_t Key(uint32_t crate, uint32_t slot, uint32_t channel)
+    {
+        return (crate << 9) | ((slot & 0x1F) << 4) | (channel & 0xF);
+    }
+
+protected:
+    // read the lines after crate, slot and channel with parse(std::istream &, T &), it returns false for a bad line
+    // returns false if the file cannot be opened, bad lines are reported and skipped
+    template<class Parse>
+    bool load(const std::string &path, const std::string &what, Parse &&parse)
+    {
+        std::ifstream ifs(path);
+        if (!ifs.is_open()) {
+            std::cout << "Cannot open " << what << " file \"" << path << "\"." << std::endl;
+            return false;
+        }
+
+        std::string line;
+        for (int iline = 1; std::getline(ifs, line); ++iline) {
+            auto pos = line.find('#');
+            if (pos != std::string::npos) { line.erase(pos); }
+            if (line.find_first_not_of(" \t\r") == std::string::npos) { continue; }
+
+            std::istringstream iss(line);
+            uint32_t crate, slot, channel;
+            T val;
+            if (!(iss >> crate >> slot >> channel) || (slot >= 32) || (channel >= FADC250_MAX_NCHANS)
+                || !parse(iss, val)) {
+                std::cout << "Skip bad " << what << " at " << path << ":" << iline << std::endl;
+                continue;
+            }
+            Set(crate, slot, channel, val);
+        }
+        return true;
+    }
+
+    // the header line, then write(std::ostream &, crate, slot, channel, const T &) for the channels sorted by crate,
+    // slot and channel
+    template<class Write>
+    void print(std::ostream &os, const std::string &header, Write &&write) const
+    {
+        std::vector<uint32_t> keys;
+        keys.reserve(_vals.size());
+        for (auto &it : _vals) { keys.push_back(it.first); }
+        std::sort(keys.begin(), keys.end());
+
+        os << header << std::endl;
+        for (auto k : keys) {
+            write(os, k >> 9, (k >> 4) & 0x1F, k & 0xF, _vals.at(k));
+        }
+    }
+
+    template<class Write>
+    bool save(const std::string &path, const std::string &what, const std::string &header, Write &&write) const
+    {
+        std::ofstream ofs(path);
+        if (!ofs.is_open()) {
+            std::cout << "Cannot write " << what << " file \"" << path << "\"." << std::endl;
+            return false;
+        }
+        print(ofs, header, write);
+        return true;
+    }
+
+    std::unordered_map<uint32_t, T> _vals;
+};
+
+}; // namespace fdec
@@ -2,6 +2,7 @@
 
 #include "TObject.h"
 
+#define FADC250_MAX_NCHANS 16
 #define FADC250_MAX_NPEAKS 4
 #define FADC250_MAX_NSAMPLES 256
 
@@ -37,22 +38,39 @@ public:
     ClassDef(Pedestal, 1);
 };
 
+// a pulse window from the pulse raw data mode, samples are in Fadc250Data::pulse_raw[offset, offset + size)
+class PulseWindow {
+public:
+    uint32_t number, first, offset, size;
+
+    PulseWindow(uint32_t n = 0, uint32_t f = 0, uint32_t o = 0, uint32_t s = 0)
+        : number(n), first(f), offset(o), size(s)
+    {
+        // place holder
+    }
+
+    ClassDef(PulseWindow, 1);
+};
+
 class Fadc250Data
 {
 public:
     Pedestal ped;
     std::vector<Peak> peaks;
     std::vector<uint32_t> raw;
+    std::vector<PulseWindow> pulses;
+    std::vector<uint32_t> pulse_raw;
 
     Fadc250Data(): ped(0., 0.)
     {
         peaks.reserve(FADC250_MAX_NPEAKS);
         raw.reserve(FADC250_MAX_NSAMPLES);
+        pulses.reserve(FADC250_MAX_NPEAKS);
     }
 
-    void Clear() { ped = Pedestal(0., 0.), peaks.clear(), raw.clear(); }
+    void Clear() { ped = Pedestal(0., 0.), peaks.clear(), raw.clear(), pulses.clear(), pulse_raw.clear(); }
 
-    ClassDef(Fadc250Data, 1);  // root io
+    ClassDef(Fadc250Data, 2);  // root io
 };
 
 }; // namespace fdec
@@ -7,58 +7,226 @@
 //
 
 #include "Fadc250Decoder.h"
+#include "Fadc250Unpack.h"
+#include <algorithm>
+#include <cstring>
 
 using namespace fdec;
 
 #define SET_BIT(n,i)  ( (n) |= (1ULL << i) )
 #define TEST_BIT(n,i)  ( (bool)( n & (1ULL << i) ) )
 
-inline void print_word(uint32_t word)
-{
-    std::cout << "0x" << std::hex << std::setw(8) << std::setfill('0') << word << std::dec << "\n";
-}
-
 inline Fadc250Data &get_channel(Fadc250Event &ev, uint32_t ch)
 {
     return ev.channels[ch];
 }
 
+// fill the samples into a container, it is sized once and trimmed after unpacking
 template<class Container>
-inline uint32_t fill_in_words(const uint32_t *buf, size_t beg, Container &raw_data, size_t max_words = -1)
-{
-    uint32_t nwords = 0;
-    for (uint32_t i = beg + 1; raw_data.size() < max_words; ++i, ++nwords) {
-        auto data = buf[i];
-        // finished
-        if ((data & 0x80000000) && nwords > 0) {
-            return nwords;
-        }
+inline uint32_t fill_in_words(const uint32_t *buf, size_t beg, size_t end, Container &raw_data, size_t max_samples)
+{
+    size_t nsamples = 0;
+    raw_data.resize(max_samples + 1);
+    auto nwords = unpack_words(buf, beg, end, &raw_data[0], max_samples, nsamples);
+    raw_data.resize(nsamples);
+    return nwords;
+}
 
-        if (!(data & 0x20000000)) {
-            raw_data.push_back((data >> 16) & 0x1FFF);
-        }
-        if (!(data & 0x2000)) {
-            raw_data.push_back((data & 0x1FFF));
-        }
-    }
+// the event layouts share the decoding loop through these helpers
+inline uint32_t event_nchans(const Fadc250Event &ev)
+{
+    return std::min<uint32_t>(ev.channels.size(), FADC250_MAX_NCHANS);
+}
+
+inline uint32_t event_nchans(const Fadc250FlatEvent &)
+{
+    return FADC250_MAX_NCHANS;
+}
+
+inline uint32_t add_window(Fadc250Event &ev, uint32_t ch, const uint32_t *buf, size_t beg, size_t end,
+                           size_t max_samples)
+{
+    return fill_in_words(buf, beg, end, get_channel(ev, ch).raw, max_samples);
+}
+
+inline uint32_t add_window(Fadc250FlatEvent &ev, uint32_t ch, const uint32_t *buf, size_t beg, size_t end,
+                           size_t max_samples)
+{
+    size_t offset = ev.samples.size(), nsamples = 0;
+    ev.samples.resize(offset + max_samples + 1);
+    auto nwords = unpack_words(buf, beg, end, &ev.samples[offset], max_samples, nsamples);
+    ev.samples.resize(offset + nsamples);
+    ev.offsets[ch] = offset;
+    ev.lengths[ch] = nsamples;
     return nwords;
 }
 
+inline uint32_t add_pulse_window(Fadc250Event &ev, uint32_t ch, uint32_t pulse_num, uint32_t first,
+                                 const uint32_t *buf, size_t beg, size_t end)
+{
+    auto &chan = get_channel(ev, ch);
+    size_t offset = chan.pulse_raw.size(), nsamples = 0;
+    chan.pulse_raw.resize(offset + FADC250_MAX_NSAMPLES + 1);
+    auto nwords = unpack_words(buf, beg, end, &chan.pulse_raw[offset], FADC250_MAX_NSAMPLES, nsamples);
+    chan.pulse_raw.resize(offset + nsamples);
+    chan.pulses.emplace_back(pulse_num, first, offset, nsamples);
+    return nwords;
+}
+
+inline uint32_t add_pulse_window(Fadc250FlatEvent &ev, uint32_t ch, uint32_t pulse_num, uint32_t first,
+                                 const uint32_t *buf, size_t beg, size_t end)
+{
+    size_t offset = ev.samples.size(), nsamples = 0;
+    ev.samples.resize(offset + FADC250_MAX_NSAMPLES + 1);
+    auto nwords = unpack_words(buf, beg, end, &ev.samples[offset], FADC250_MAX_NSAMPLES, nsamples);
+    ev.samples.resize(offset + nsamples);
+    ev.pulses.emplace_back(pulse_num, first, offset, nsamples);
+    ev.pulse_channels.push_back(ch);
+    return nwords;
+}
+
+inline void grow_events(std::vector<Fadc250Event> &events, size_t n, size_t nchans)
+{
+    events.resize(n, Fadc250Event(0, nchans));
+}
+
+inline void grow_events(std::vector<Fadc250FlatEvent> &events, size_t n, size_t)
+{
+    events.resize(n);
+}
+
+// peaks are added channel by channel
+inline void begin_peaks(Fadc250Event &, uint32_t) {}
+
+inline void begin_peaks(Fadc250FlatEvent &ev, uint32_t ch)
+{
+    ev.peak_offsets[ch] = ev.peaks.size();
+}
+
+inline void add_peak(Fadc250Event &ev, uint32_t ch, double height, double integral, double time)
+{
+    ev.channels[ch].peaks.emplace_back(height, integral, time);
+}
+
+inline void add_peak(Fadc250FlatEvent &ev, uint32_t ch, double height, double integral, double time)
+{
+    ev.peaks.emplace_back(height, integral, time);
+    ev.npeaks[ch]++;
+}
+
 
 Fadc250Decoder::Fadc250Decoder(double clk)
-: _clk(clk)
+: _clk(clk), _chan_mask(0xFFFF)
 {
-    // place holder
+    SetVariant(Fadc250Variant::Auto);
+}
+
+const char *fdec::DecodeError2str(DecodeError err)
+{
+    switch (err) {
+    case DecodeError::BadBlockHeader: return "bad block header";
+    case DecodeError::BadEventHeader: return "bad event header";
+    case DecodeError::UnexpectedType: return "unexpected data type";
+    case DecodeError::StrayDataWord: return "stray data word";
+    case DecodeError::TooManyEvents: return "too many events";
+    case DecodeError::EventCountMismatch: return "event count mismatch";
+    case DecodeError::TrailerWordCount: return "trailer word count";
+    case DecodeError::MissingTrailer: return "missing trailer";
+    case DecodeError::BadChannel: return "bad channel";
+    default: return "unknown";
+    }
+}
+
+uint64_t Fadc250DecodeStats::Count(DecodeError err) const
+{
+    uint64_t res = 0;
+    for (auto &slot : counts) { res += slot[static_cast<int>(err)]; }
+    return res;
+}
+
+uint64_t Fadc250DecodeStats::Total() const
+{
+    uint64_t res = 0;
+    for (int i = 0; i < static_cast<int>(DecodeError::Max); ++i) { res += Count(static_cast<DecodeError>(i)); }
+    return res;
+}
+
+void Fadc250DecodeStats::Reset()
+{
+    std::memset(counts, 0, sizeof(counts));
+    samples.clear();
+}
+
+void Fadc250DecodeStats::PrintSummary(std::ostream &os) const
+{
+    if (!Total()) {
+        os << "Fadc250Decoder: no decoding errors.\n";
+        return;
+    }
+
+    os << "Fadc250Decoder: " << Total() << " decoding errors.\n";
+    for (int i = 0; i < FADC250_MAX_NSLOTS; ++i) {
+        for (int j = 0; j < static_cast<int>(DecodeError::Max); ++j) {
+            if (counts[i][j]) {
+                os << "    slot " << std::setw(2) << i << ", " << std::setw(20) << std::left
+                   << DecodeError2str(static_cast<DecodeError>(j)) << std::right << ": " << counts[i][j] << "\n";
+            }
+        }
+    }
+    for (auto &sample : samples) {
+        os << "    slot " << std::setw(2) << sample.slot << ", " << DecodeError2str(sample.error)
+           << " at word " << sample.index << ": 0x" << std::hex << std::setw(8) << std::setfill('0') << sample.word
+           << std::setfill(' ') << std::dec << "\n";
+    }
 }
 
 // a help structure to save peak infos
 struct PeakBuffer {
-    uint32_t height = 0., integral = 0., time = 0.;
-    bool in_data = false;
+    uint32_t height, integral, time;
+};
+
+// fixed-size peak staging for all channels, it lives on the stack so decoding does not touch the heap
+// only the masks (one bit per pulse in data) need to be reset for an event
+struct PeakStaging {
+    PeakBuffer peaks[FADC250_MAX_NCHANS][FADC250_MAX_NPEAKS];
+    uint32_t masks[FADC250_MAX_NCHANS];
+
+    PeakStaging() { std::memset(masks, 0, sizeof(masks)); }
+
+    PeakBuffer &Get(uint32_t ch, uint32_t pulse_num)
+    {
+        auto &peak = peaks[ch][pulse_num];
+        if (!TEST_BIT(masks[ch], pulse_num)) {
+            peak = PeakBuffer{0, 0, 0};
+            SET_BIT(masks[ch], pulse_num);
+        }
+        return peak;
+    }
 };
 
-void Fadc250Decoder::DecodeEvent(Fadc250Event &res, const uint32_t *buf, size_t buflen)
-const
+void Fadc250Decoder::DecodeEvent(Fadc250Event &event, const uint32_t *buf, size_t buflen)
+{
+    decodeEvent(event, buf, buflen);
+}
+
+void Fadc250Decoder::DecodeEvent(Fadc250FlatEvent &event, const uint32_t *buf, size_t buflen)
+{
+    decodeEvent(event, buf, buflen);
+}
+
+size_t Fadc250Decoder::DecodeBlock(std::vector<Fadc250Event> &events, const uint32_t *buf, size_t buflen,
+                                   size_t nchans)
+{
+    return decodeBlock(events, buf, buflen, nchans);
+}
+
+size_t Fadc250Decoder::DecodeBlock(std::vector<Fadc250FlatEvent> &events, const uint32_t *buf, size_t buflen)
+{
+    return decodeBlock(events, buf, buflen, FADC250_MAX_NCHANS);
+}
+
+template<class Event>
+void Fadc250Decoder::decodeEvent(Event &res, const uint32_t *buf, size_t buflen)
 {
     res.Clear();
 
@@ -69,116 +237,296 @@ const
 
     auto header = buf[0];
     if (!(header & 0x80000000) || ((header >> 27) & 0xF) != EventHeader) {
-        std::cout << "Fadc250Decoder Error: incorrect event header:";
-        print_word(buf[0]);
+        _stats.Record((header >> 22) & 0x1F, DecodeError::BadEventHeader, header, 0);
         return;
     }
 
+    uint32_t slot = (header >> 22) & 0x1F;
     res.number = (header & 0x3FFFFF);
-    std::vector<std::vector<PeakBuffer>> peak_buffers(res.channels.size());
+    size_t iw = decodeWords(res, buf, 1, buflen, slot);
+    if (iw < buflen) {
+        _stats.Record(slot, DecodeError::UnexpectedType, buf[iw], iw);
+    }
+}
+
+// decode a slot block: block header, N events, block trailer
+template<class Event>
+size_t Fadc250Decoder::decodeBlock(std::vector<Event> &events, const uint32_t *buf, size_t buflen, size_t nchans)
+{
+    if (!buflen) {
+        return 0;
+    }
+
+    auto header = buf[0];
+    if (!(header & 0x80000000) || ((header >> 27) & 0xF) != BlockHeader) {
+        _stats.Record((header >> 22) & 0x1F, DecodeError::BadBlockHeader, header, 0);
+        return 0;
+    }
+    uint32_t slot = (header >> 22) & 0x1F;
+    uint32_t nevents = header & 0xFF;
+    // only grows, so the events (and their buffers) are reused between blocks
+    if (events.size() < nevents) {
+        grow_events(events, nevents, nchans);
+    }
+
+    size_t iw = 1, nev = 0;
+    while (iw < buflen) {
+        uint32_t data = buf[iw];
+        uint32_t type = (data >> 27) & 0xF;
+        if (!(data & 0x80000000) || (type == FillerWord)) {
+            ++iw;
+            continue;
+        }
+
+        if (type == EventHeader) {
+            if (nev >= nevents) {
+                _stats.Record(slot, DecodeError::TooManyEvents, data, iw);
+                return nev;
+            }
+            auto &res = events[nev++];
+            res.Clear();
+            res.number = (data & 0x3FFFFF);
+            iw = decodeWords(res, buf, iw + 1, buflen, slot);
+        } else if (type == BlockTrailer) {
+            // words in the block, including the header and trailer
+            uint32_t nwords = data & 0x3FFFFF;
+            if (nwords != iw + 1) {
+                _stats.Record(slot, DecodeError::TrailerWordCount, data, iw);
+            }
+            if (nev != nevents) {
+                _stats.Record(slot, DecodeError::EventCountMismatch, header, 0);
+            }
+            return nev;
+        } else {
+            _stats.Record(slot, DecodeError::UnexpectedType, data, iw);
+            // skip the rest of the event
+            for (++iw; (iw < buflen) && !(buf[iw] & 0x80000000); ++iw) {}
+            for (; iw < buflen; ++iw) {
+                uint32_t t = (buf[iw] >> 27) & 0xF;
+                if ((buf[iw] & 0x80000000) && ((t == EventHeader) || (t == BlockTrailer))) { break; }
+            }
+        }
+    }
+
+    _stats.Record(slot, DecodeError::MissingTrailer, buf[buflen - 1], buflen - 1);
+    return nev;
+}
+
+// data types handled by each variant, the others fall back to the mixed decoding
+#define FADC250_TYPE_BIT(t) (1u << (t))
+#define FADC250_COMMON_TYPES (FADC250_TYPE_BIT(TriggerTime) | FADC250_TYPE_BIT(Scaler) \
+                              | FADC250_TYPE_BIT(InvalidData) | FADC250_TYPE_BIT(FillerWord))
+#define FADC250_WINDOW_RAW_TYPES (FADC250_COMMON_TYPES | FADC250_TYPE_BIT(WindowRawData))
+#define FADC250_PULSE_TYPES (FADC250_COMMON_TYPES | FADC250_TYPE_BIT(PulseIntegral) | FADC250_TYPE_BIT(PulseTime))
+#define FADC250_MIXED_TYPES (FADC250_WINDOW_RAW_TYPES | FADC250_PULSE_TYPES | FADC250_TYPE_BIT(PulseRawData))
+
+// choose the narrowest variant that covers the data types in the block (or event)
+Fadc250Variant Fadc250Decoder::SelectVariant(const uint32_t *buf, size_t buflen)
+{
+    uint32_t types = 0;
+    for (size_t i = 0; i < buflen; ++i) {
+        if (buf[i] & 0x80000000) {
+            uint32_t type = (buf[i] >> 27) & 0xF;
+            // skip the data words of a scaler block
+            if (type == Scaler) { i += (buf[i] & 0x3F); }
+            SET_BIT(types, type);
+        }
+    }
+    types &= ~(FADC250_TYPE_BIT(BlockHeader) | FADC250_TYPE_BIT(BlockTrailer) | FADC250_TYPE_BIT(EventHeader));
+
+    if (!(types & ~FADC250_WINDOW_RAW_TYPES)) {
+        return Fadc250Variant::WindowRaw;
+    } else if (!(types & ~FADC250_PULSE_TYPES)) {
+        return Fadc250Variant::PulseIntegralTime;
+    }
+    return Fadc250Variant::Mixed;
+}
+
+void Fadc250Decoder::SetVariant(Fadc250Variant var)
+{
+    _variant = var;
+    switch (var) {
+    case Fadc250Variant::WindowRaw:
+        _decode = &Fadc250Decoder::decodeWordsT<FADC250_WINDOW_RAW_TYPES, Fadc250Event>;
+        _decode_flat = &Fadc250Decoder::decodeWordsT<FADC250_WINDOW_RAW_TYPES, Fadc250FlatEvent>;
+        break;
+    case Fadc250Variant::PulseIntegralTime:
+        _decode = &Fadc250Decoder::decodeWordsT<FADC250_PULSE_TYPES, Fadc250Event>;
+        _decode_flat = &Fadc250Decoder::decodeWordsT<FADC250_PULSE_TYPES, Fadc250FlatEvent>;
+        break;
+    default:
+        _decode = &Fadc250Decoder::decodeWordsT<FADC250_MIXED_TYPES, Fadc250Event>;
+        _decode_flat = &Fadc250Decoder::decodeWordsT<FADC250_MIXED_TYPES, Fadc250FlatEvent>;
+        break;
+    }
+}
+
+// decode with the selected variant, an event with data types out of the variant is decoded again by the mixed one
+// and the decoder stays with the mixed variant, the errors of the discarded pass are not counted
+template<class Event>
+size_t Fadc250Decoder::decodeWords(Event &res, const uint32_t *buf, size_t beg, size_t buflen, uint32_t slot)
+{
+    if (_variant == Fadc250Variant::Auto) {
+        SetVariant(SelectVariant(buf + beg, buflen - beg));
+    }
+
+    auto mark = _stats.GetMark(slot);
+    size_t iw = (this->*getDecode(res))(res, buf, beg, buflen, slot);
+    if ((iw < buflen) && (_variant != Fadc250Variant::Mixed)) {
+        // a valid type that is not handled by the variant
+        if (FADC250_MIXED_TYPES & FADC250_TYPE_BIT((buf[iw] >> 27) & 0xF)) {
+            _stats.Rewind(slot, mark);
+            SetVariant(Fadc250Variant::Mixed);
+            uint32_t number = res.number;
+            res.Clear();
+            res.number = number;
+            iw = (this->*getDecode(res))(res, buf, beg, buflen, slot);
+        }
+    }
+    return iw;
+}
+
+// decode the data words of an event from buf[beg], until the next event header, block header/trailer or an
+// unexpected data type, returns the index where it stops
+// Types is the mask of data types the variant handles, the branches for other types are removed at compile time
+template<uint32_t Types, class Event>
+size_t Fadc250Decoder::decodeWordsT(Event &res, const uint32_t *buf, size_t beg, size_t buflen, uint32_t slot)
+{
+    PeakStaging staging;
+    uint32_t nchans = event_nchans(res);
+    uint32_t chan_mask = _chan_mask;
     uint32_t type = FillerWord;
+    size_t iw = beg;
 
-    for (size_t iw = 1; iw < buflen; ++iw) {
+    for (; iw < buflen; ++iw) {
         uint32_t data = buf[iw];
 
         // new type word, update the current type
         bool new_type = (data & 0x80000000);
         if (new_type) {
             type = (data >> 27) & 0xF;
-            SET_BIT(res.mode, type);
+            // the end of this event
+            if ((type == EventHeader) || (type == BlockHeader) || (type == BlockTrailer)) {
+                break;
+            }
+            // not handled by this variant
+            if (!(Types & FADC250_TYPE_BIT(type))) {
+                return iw;
+            }
+            // fillers only pad the block, they are not a part of the event data
+            if (type != FillerWord) {
+                SET_BIT(res.mode, type);
+            }
         }
 
         switch (type) {
-        // trigger timing, two timing words - 24 bit each
+        // trigger timing, two timing words - 24 bit each, the first one has bits 23-0 and the second one bits 47-24
         case TriggerTime:
             if (new_type) {
                 res.time = data & 0xFFFFFF;
             } else {
-                uint64_t time = (res.time << 24);
-                res.time = time | (data & 0xFFFFFF);
+                res.time |= static_cast<uint64_t>(data & 0xFFFFFF) << 24;
             }
-            // print_word(data);
             break;
         // window raw data
         case WindowRawData:
-            if (new_type) {
+            if (!(Types & FADC250_TYPE_BIT(WindowRawData))) {
+                break;
+            } else if (new_type) {
                 // get channel and window size
                 uint32_t ch = (data >> 23) & 0xF;
                 size_t nwords= (data & 0xFFF);
-                auto &raw_data = get_channel(res, ch).raw;
-                raw_data.clear();
-                iw += fill_in_words(buf, iw, raw_data, nwords);
+                if ((ch < nchans) && TEST_BIT(chan_mask, ch)) {
+                    iw += add_window(res, ch, buf, iw, buflen, nwords);
+                } else {
+                    if (ch >= nchans) {
+                        _stats.Record(slot, DecodeError::BadChannel, data, iw);
+                    }
+                    // masked out or a bad channel, skip the sample words (two samples per word) without unpacking
+                    iw += std::min((nwords + 1)/2, buflen - iw - 1);
+                }
             } else {
-                std::cout << "Fadc250Decoder Error: unexpected window raw data word. ";
-                print_word(data);
+                _stats.Record(slot, DecodeError::StrayDataWord, data, iw);
             }
             break;
-        // pulse raw data, TODO: currently unsupported
+        // pulse raw data, samples around the pulses, appended to the channel's pulse_raw
         case PulseRawData:
-            std::cout << "Fadc250Decoder Warning: unsupported data mode: pulse raw data, skip it" << std::endl;
-            /*
-            {
+            if (!(Types & FADC250_TYPE_BIT(PulseRawData))) {
+                break;
+            } else if (new_type) {
                 uint32_t ch = (data >> 23) & 0xF;
                 uint32_t pulse_num = (data >> 21) & 0x3;
                 uint32_t first_sample = data & 0x3FF;
+                if ((ch < nchans) && TEST_BIT(chan_mask, ch)) {
+                    iw += add_pulse_window(res, ch, pulse_num, first_sample, buf, iw, buflen);
+                } else {
+                    if (ch >= nchans) {
+                        _stats.Record(slot, DecodeError::BadChannel, data, iw);
+                    }
+                    // masked out or a bad channel, the window size is not in the header, skip to the next type word
+                    while ((iw + 1 < buflen) && !(buf[iw + 1] & 0x80000000)) { ++iw; }
+                }
+            } else {
+                _stats.Record(slot, DecodeError::StrayDataWord, data, iw);
             }
-            */
             break;
         // pulse integral
         case PulseIntegral:
-            {
+            if (Types & FADC250_TYPE_BIT(PulseIntegral)) {
                 uint32_t ch = (data >> 23) & 0xF;
                 uint32_t pulse_num = (data >> 21) & 0x3;
                 // uint32_t quality = (data >> 19) & 0x3;
-                if (peak_buffers[ch].size() < pulse_num + 1) {
-                    peak_buffers[ch].resize(4);
+                if ((ch < nchans) && TEST_BIT(chan_mask, ch)) {
+                    staging.Get(ch, pulse_num).integral = data & 0x7FFFF;
                 }
-                peak_buffers[ch][pulse_num].integral = data & 0x7FFFF;
-                peak_buffers[ch][pulse_num].in_data = true;
             }
             break;
         case PulseTime:
-            {
+            if (Types & FADC250_TYPE_BIT(PulseTime)) {
                 uint32_t ch = (data >> 23) & 0xF;
                 uint32_t pulse_num = (data >> 21) & 0x3;
                 // uint32_t quality = (data >> 19) & 0x3;
-                auto &chan = get_channel(res, ch);
-                if (peak_buffers[ch].size() < pulse_num + 1) {
-                    peak_buffers[ch].resize(4);
-                }
                 // convert to ns (1e3 / _clk (MHz) / 64)
-                peak_buffers[ch][pulse_num].time = data & 0xFFFF;
-                peak_buffers[ch][pulse_num].in_data = true;
+                if ((ch < nchans) && TEST_BIT(chan_mask, ch)) {
+                    staging.Get(ch, pulse_num).time = data & 0xFFFF;
+                }
             }
             break;
+        // scaler block, the header is followed by nwords 32-bit counters (any bit can be set)
         case Scaler:
-            // TODO
-            // std::cout << "Scaler word: nwords = " << (data & 0x3F) << std::endl;
+            if (new_type) {
+                size_t nwords = std::min<size_t>(data & 0x3F, buflen - iw - 1);
+                res.scalers.assign(buf + iw + 1, buf + iw + 1 + nwords);
+                iw += nwords;
+            }
             break;
         case InvalidData:
         case FillerWord:
             break;
         default:
-            std::cout << "Error: unexpected data type " << type << " in header processing. ";
-            print_word(data);
-            return;
+            // let the caller handle it, peaks are not filled for a corrupted event
+            return iw;
         }
     }
 
     // fill peak buffers to result
-    for (size_t i = 0; i < peak_buffers.size(); ++i) {
-        for (auto &peak : peak_buffers[i]) {
-            if (!peak.in_data) {
+    if (!(Types & (FADC250_TYPE_BIT(PulseIntegral) | FADC250_TYPE_BIT(PulseTime)))) {
+        return iw;
+    }
+    for (uint32_t i = 0; i < nchans; ++i) {
+        begin_peaks(res, i);
+        for (uint32_t j = 0; staging.masks[i] && (j < FADC250_MAX_NPEAKS); ++j) {
+            if (!TEST_BIT(staging.masks[i], j)) {
                 continue;
             }
+            auto &peak = staging.peaks[i][j];
             // time conversion: 1000/(clk/MHz*64) ns
-            res.channels[i].peaks.emplace_back(static_cast<double>(peak.height),
-                                               static_cast<double>(peak.integral),
-                                               static_cast<double>(peak.time)*15.625/_clk);
+            add_peak(res, i, static_cast<double>(peak.height), static_cast<double>(peak.integral),
+                     static_cast<double>(peak.time)*15.625/_clk);
         }
     }
 
-    return;
+    return iw;
 }
 
 
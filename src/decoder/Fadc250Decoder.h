@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include "Fadc250Data.h"
@@ -20,6 +21,8 @@ namespace fdec
 
 // data type
 enum Fadc250Type {
+    BlockHeader = 0,
+    BlockTrailer = 1,
     EventHeader = 2,
     TriggerTime = 3,
     WindowRawData = 4,
@@ -34,35 +37,190 @@ enum Fadc250Type {
     FillerWord = 15,
 };
 
+// decoding errors, they are counted instead of printed
+enum class DecodeError : int {
+    BadBlockHeader = 0,     // the first word is not a block header
+    BadEventHeader,         // the first word is not an event header
+    UnexpectedType,         // unknown data type in the event
+    StrayDataWord,          // a continuation word without a proper type word
+    TooManyEvents,          // more event headers than the block header claims
+    EventCountMismatch,     // less events than the block header claims
+    TrailerWordCount,       // block trailer word count does not match
+    MissingTrailer,         // no block trailer in the buffer
+    BadChannel,             // a raw data channel beyond the channels of the event
+    Max,
+};
+
+const char *DecodeError2str(DecodeError err);
+
+#define FADC250_MAX_NSLOTS 32
+
+struct Fadc250DecodeStats
+{
+    // an offending word, index is its position in the decoded buffer
+    struct Sample {
+        uint32_t slot, word;
+        size_t index;
+        DecodeError error;
+    };
+
+    uint64_t counts[FADC250_MAX_NSLOTS][static_cast<int>(DecodeError::Max)];
+    std::vector<Sample> samples;
+    size_t max_samples;
+
+    Fadc250DecodeStats(size_t nsamples = 16) : max_samples(nsamples) { samples.reserve(nsamples); Reset(); }
+
+    // hot path, counts and keeps the first max_samples words, no formatting here
+    void Record(uint32_t slot, DecodeError err, uint32_t word, size_t index)
+    {
+        counts[slot & (FADC250_MAX_NSLOTS - 1)][static_cast<int>(err)]++;
+        if (samples.size() < max_samples) {
+            samples.push_back(Sample{slot, word, index, err});
+        }
+    }
+
+    // the errors of a slot since a mark, they can be dropped if the decoding is discarded and done again
+    struct Mark {
+        uint64_t counts[static_cast<int>(DecodeError::Max)];
+        size_t nsamples;
+    };
+
+    Mark GetMark(uint32_t slot) const
+    {
+        Mark mark;
+        std::copy_n(counts[slot & (FADC250_MAX_NSLOTS - 1)], static_cast<int>(DecodeError::Max), mark.counts);
+        mark.nsamples = samples.size();
+        return mark;
+    }
+
+    void Rewind(uint32_t slot, const Mark &mark)
+    {
+        std::copy_n(mark.counts, static_cast<int>(DecodeError::Max), counts[slot & (FADC250_MAX_NSLOTS - 1)]);
+        if (samples.size() > mark.nsamples) { samples.resize(mark.nsamples); }
+    }
+
+    uint64_t Count(DecodeError err) const;
+    uint64_t Total() const;
+    void Reset();
+    void PrintSummary(std::ostream &os = std::cout) const;
+};
+
 class Fadc250Event
 {
 public:
     uint32_t number, mode;
     uint64_t time;
     std::vector<Fadc250Data> channels;
+    // scaler counters, the first FADC250_MAX_NCHANS are for the channels
+    std::vector<uint32_t> scalers;
 
     Fadc250Event(uint32_t n = 0, uint32_t nch = 16)
         : number(n), mode(0)
     {
         channels.resize(nch);
+        scalers.reserve(64);
     }
 
     void Clear()
     {
         mode = 0;
         time = 0;
+        scalers.clear();
         for (auto &ch : channels) { ch.Clear(); }
     }
 };
 
+// structure-of-arrays event, all samples are in one arena and all peaks are in one array
+// channel i has samples[offsets[i], offsets[i] + lengths[i]) and peaks[peak_offsets[i], peak_offsets[i] + npeaks[i])
+class Fadc250FlatEvent
+{
+public:
+    uint32_t number, mode;
+    uint64_t time;
+    std::vector<uint32_t> scalers;
+
+    // window raw samples and pulse raw samples
+    std::vector<uint32_t> samples;
+    uint32_t offsets[FADC250_MAX_NCHANS], lengths[FADC250_MAX_NCHANS];
+
+    std::vector<Peak> peaks;
+    uint32_t peak_offsets[FADC250_MAX_NCHANS], npeaks[FADC250_MAX_NCHANS];
+
+    // pulse raw windows (offsets are in samples) and their channels
+    std::vector<PulseWindow> pulses;
+    std::vector<uint32_t> pulse_channels;
+
+    Fadc250FlatEvent(uint32_t n = 0)
+        : number(n), mode(0), time(0)
+    {
+        scalers.reserve(64);
+        samples.reserve(FADC250_MAX_NCHANS*FADC250_MAX_NSAMPLES);
+        peaks.reserve(FADC250_MAX_NCHANS*FADC250_MAX_NPEAKS);
+        Clear();
+    }
+
+    void Clear()
+    {
+        mode = 0;
+        time = 0;
+        scalers.clear();
+        samples.clear();
+        peaks.clear();
+        pulses.clear();
+        pulse_channels.clear();
+        std::fill(offsets, offsets + FADC250_MAX_NCHANS, 0);
+        std::fill(lengths, lengths + FADC250_MAX_NCHANS, 0);
+        std::fill(peak_offsets, peak_offsets + FADC250_MAX_NCHANS, 0);
+        std::fill(npeaks, npeaks + FADC250_MAX_NCHANS, 0);
+    }
+
+    const uint32_t *Samples(uint32_t ch) const { return samples.data() + offsets[ch]; }
+    const Peak *Peaks(uint32_t ch) const { return peaks.data() + peak_offsets[ch]; }
+
+    // adapters to the per-channel structures (for root output)
+    void ToData(uint32_t ch, Fadc250Data &data) const
+    {
+        data.Clear();
+        data.raw.assign(Samples(ch), Samples(ch) + lengths[ch]);
+        data.peaks.assign(Peaks(ch), Peaks(ch) + npeaks[ch]);
+        for (size_t i = 0; i < pulses.size(); ++i) {
+            if (pulse_channels[i] != ch) { continue; }
+            auto &pulse = pulses[i];
+            data.pulses.emplace_back(pulse.number, pulse.first, data.pulse_raw.size(), pulse.size);
+            data.pulse_raw.insert(data.pulse_raw.end(), samples.begin() + pulse.offset,
+                                  samples.begin() + pulse.offset + pulse.size);
+        }
+    }
+
+    void ToEvent(Fadc250Event &event) const
+    {
+        event.number = number;
+        event.mode = mode;
+        event.time = time;
+        event.scalers = scalers;
+        for (uint32_t i = 0; (i < event.channels.size()) && (i < FADC250_MAX_NCHANS); ++i) {
+            ToData(i, event.channels[i]);
+        }
+    }
+};
+
+// decoder variants for the firmware configurations, each one only compiles the branches for its data types
+enum class Fadc250Variant : int {
+    Auto = 0,               // selected by the first decoded block (or event)
+    WindowRaw,              // window raw data only
+    PulseIntegralTime,      // pulse integral and pulse time only
+    Mixed,                  // all data types
+};
+
 class Fadc250Decoder
 {
 public:
     Fadc250Decoder(double clk = 250.);
 
+    // the decoding counts its errors in the decoder, so a decoder is not shared between threads (one per thread)
     // for an event data
-    void DecodeEvent(Fadc250Event &event, const uint32_t *buf, size_t len) const;
-    inline Fadc250Event DecodeEvent(const uint32_t *buf, size_t len, size_t nchans = 16) const
+    void DecodeEvent(Fadc250Event &event, const uint32_t *buf, size_t len);
+    inline Fadc250Event DecodeEvent(const uint32_t *buf, size_t len, size_t nchans = 16)
     {
         Fadc250Event evt;
         evt.channels.resize(nchans);
@@ -70,8 +228,70 @@ public:
         return evt;
     }
 
+    // for a slot block (block header, events, block trailer), events are filled from the front and the vector only
+    // grows, returns the number of decoded events
+    size_t DecodeBlock(std::vector<Fadc250Event> &events, const uint32_t *buf, size_t len, size_t nchans = 16);
+
+    // the same for the structure-of-arrays event
+    void DecodeEvent(Fadc250FlatEvent &event, const uint32_t *buf, size_t len);
+    size_t DecodeBlock(std::vector<Fadc250FlatEvent> &events, const uint32_t *buf, size_t len);
+
+    // decoding errors since the last reset
+    const Fadc250DecodeStats &GetStats() const { return _stats; }
+    void ResetStats() { _stats.Reset(); }
+    void SetErrorSampling(size_t nsamples) { _stats.max_samples = nsamples; _stats.samples.reserve(nsamples); }
+    void PrintStats(std::ostream &os = std::cout) const { _stats.PrintSummary(os); }
+
+    // only the channels with their bits set are decoded, the others are skipped without unpacking
+    void SetChannelMask(uint32_t mask) { _chan_mask = mask & 0xFFFF; }
+    uint32_t GetChannelMask() const { return _chan_mask; }
+
+    // decoder variant, Auto selects it again from the next decoded data
+    void SetVariant(Fadc250Variant var);
+    Fadc250Variant GetVariant() const { return _variant; }
+    static Fadc250Variant SelectVariant(const uint32_t *buf, size_t len);
+
+    // split a data bank into the slot blocks (block header to block trailer), the scaler counters are skipped when
+    // looking for the trailer, func(slot, block, len) is called for each block, returns the number of blocks
+    template<class Func>
+    static size_t SplitBlocks(const uint32_t *buf, size_t len, Func &&func)
+    {
+        size_t nblocks = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if ((buf[i] & 0xF8000000) != 0x80000000) { continue; }
+            size_t end = i + 1;
+            for (; (end < len) && ((buf[end] & 0xF8000000) != 0x88000000); ++end) {
+                if ((buf[end] & 0xF8000000) == 0xE0000000) { end += buf[end] & 0x3F; }
+            }
+            func((buf[i] >> 22) & 0x1F, buf + i, std::min(end + 1, len) - i);
+            nblocks++;
+            i = end;
+        }
+        return nblocks;
+    }
+
 private:
+    template<class Event>
+    using DecodeFn = size_t (Fadc250Decoder::*)(Event &, const uint32_t *, size_t, size_t, uint32_t);
+
+    template<class Event>
+    void decodeEvent(Event &event, const uint32_t *buf, size_t len);
+    template<class Event>
+    size_t decodeBlock(std::vector<Event> &events, const uint32_t *buf, size_t len, size_t nchans);
+    template<class Event>
+    size_t decodeWords(Event &event, const uint32_t *buf, size_t beg, size_t len, uint32_t slot);
+    template<uint32_t Types, class Event>
+    size_t decodeWordsT(Event &event, const uint32_t *buf, size_t beg, size_t len, uint32_t slot);
+
+    DecodeFn<Fadc250Event> getDecode(const Fadc250Event &) const { return _decode; }
+    DecodeFn<Fadc250FlatEvent> getDecode(const Fadc250FlatEvent &) const { return _decode_flat; }
+
     double _clk;
+    uint32_t _chan_mask;
+    Fadc250DecodeStats _stats;
+    Fadc250Variant _variant;
+    DecodeFn<Fadc250Event> _decode;
+    DecodeFn<Fadc250FlatEvent> _decode_flat;
 };
 
 }; // namespace fdec
@@ -0,0 +1,135 @@
+//
+// A synthetic data generator for the JLab FADC250
+// Data format: https://www.jlab.org/Hall-B/ftof/manuals/FADC250UsersManual.pdf
+//
+
+#include "Fadc250Generator.h"
+#include <algorithm>
+#include <cmath>
+
+
+using namespace fdec;
+
+#define FADC250_TYPE_WORD(type) (0x80000000 | ((type) << 27))
+
+Fadc250Generator::Fadc250Generator(const Fadc250GenConfig &config)
+: _cfg(config), _rng(config.seed), _nevents(0), _nblocks(0), _time(0)
+{
+    _cfg.nchans = std::min<uint32_t>(_cfg.nchans, 16);
+    _cfg.nsamples = std::min<uint32_t>(_cfg.nsamples, 0xFFF) & ~1u;
+    _cfg.block_level = std::max<uint32_t>(std::min<uint32_t>(_cfg.block_level, 0xFF), 1);
+}
+
+size_t Fadc250Generator::GenerateBlock(std::vector<uint32_t> &buf)
+{
+    size_t beg = buf.size();
+    // block header: slot, module id (1 for FADC250), block number, number of events
+    buf.push_back(FADC250_TYPE_WORD(0) | ((_cfg.slot & 0x1F) << 22) | (1 << 18) | ((_nblocks & 0x3FF) << 8)
+                  | _cfg.block_level);
+    for (uint32_t i = 0; i < _cfg.block_level; ++i) {
+        generateEvent(buf);
+    }
+    // the block is padded to an even number of words (with the trailer)
+    if ((buf.size() - beg) % 2 == 0) {
+        buf.push_back(FADC250_TYPE_WORD(15));
+    }
+    // block trailer: slot, number of words in the block
+    buf.push_back(FADC250_TYPE_WORD(1) | ((_cfg.slot & 0x1F) << 22) | ((buf.size() - beg + 1) & 0x3FFFFF));
+    _nblocks++;
+    return buf.size() - beg;
+}
+
+// the pulse shape, its maximum is 1 at t = rise
+inline double pulse_shape(double t, double rise, double decay)
+{
+    if (t <= 0.) { return 0.; }
+    if (t < rise) { return t/rise; }
+    return std::exp(-(t - rise)/decay);
+}
+
+void Fadc250Generator::generateWaveform(std::vector<uint32_t> &samples)
+{
+    std::normal_distribution<double> noise(_cfg.pedestal, _cfg.noise);
+    std::uniform_real_distribution<double> uni(0., 1.);
+
+    // pulses (with pile-up) at random positions in the window
+    double pos[2] = {-1., -1.}, height[2] = {0., 0.};
+    if (uni(_rng) < _cfg.pulse_prob) {
+        pos[0] = uni(_rng)*0.6*_cfg.nsamples + 0.1*_cfg.nsamples;
+        height[0] = _cfg.min_height + uni(_rng)*(_cfg.max_height - _cfg.min_height);
+        if (uni(_rng) < _cfg.pileup_prob) {
+            pos[1] = pos[0] + _cfg.rise + uni(_rng)*3.*_cfg.decay;
+            height[1] = _cfg.min_height + uni(_rng)*(_cfg.max_height - _cfg.min_height);
+        }
+    }
+
+    samples.resize(_cfg.nsamples);
+    for (uint32_t i = 0; i < _cfg.nsamples; ++i) {
+        double val = noise(_rng);
+        for (int j = 0; j < 2; ++j) {
+            if (pos[j] >= 0.) { val += height[j]*pulse_shape(i - pos[j], _cfg.rise, _cfg.decay); }
+        }
+        // 12-bit adc, bit 12 marks the overflow
+        long adc = std::lround(val);
+        samples[i] = (adc < 0) ? 0 : ((adc > 4095) ? (4095 | 0x1000) : static_cast<uint32_t>(adc));
+    }
+}
+
+void Fadc250Generator::generateEvent(std::vector<uint32_t> &buf)
+{
+    // event header: slot, event number
+    buf.push_back(FADC250_TYPE_WORD(2) | ((_cfg.slot & 0x1F) << 22) | (_nevents & 0x3FFFFF));
+    // trigger time, two words with 24 bits each, bits 23-0 first and then bits 47-24
+    _time += _cfg.trigger_interval;
+    buf.push_back(FADC250_TYPE_WORD(3) | (_time & 0xFFFFFF));
+    buf.push_back((_time >> 24) & 0xFFFFFF);
+
+    for (uint32_t ch = 0; ch < _cfg.nchans; ++ch) {
+        generateWaveform(_samples);
+        auto &s = _samples;
+
+        if (_cfg.mode & kGenWindowRaw) {
+            buf.push_back(FADC250_TYPE_WORD(4) | (ch << 23) | _cfg.nsamples);
+            for (uint32_t i = 0; i + 1 < s.size(); i += 2) {
+                buf.push_back((s[i] << 16) | s[i + 1]);
+            }
+        }
+
+        if (!(_cfg.mode & (kGenPulseIntegralTime | kGenPulseRaw))) {
+            continue;
+        }
+
+        // pulses from the threshold crossings, up to 4 as the firmware
+        double thres = _cfg.pedestal + _cfg.threshold;
+        uint32_t npulses = 0;
+        for (uint32_t i = 1; (i < s.size()) && (npulses < 4); ++i) {
+            if ((s[i - 1] & 0xFFF) >= thres || (s[i] & 0xFFF) < thres) {
+                continue;
+            }
+            uint32_t beg = (i > _cfg.nsb) ? i - _cfg.nsb : 0;
+            uint32_t end = std::min<uint32_t>(i + _cfg.nsa, s.size());
+
+            if (_cfg.mode & kGenPulseRaw) {
+                buf.push_back(FADC250_TYPE_WORD(6) | (ch << 23) | (npulses << 21) | (beg & 0x3FF));
+                for (uint32_t j = beg; j < end; j += 2) {
+                    // the second sample of the last word is marked not valid
+                    uint32_t lo = (j + 1 < end) ? (s[j + 1] & 0x1FFF) : 0x2000;
+                    buf.push_back(((s[j] & 0x1FFF) << 16) | lo);
+                }
+            }
+
+            if (_cfg.mode & kGenPulseIntegralTime) {
+                uint32_t integral = 0;
+                for (uint32_t j = beg; j < end; ++j) { integral += s[j] & 0xFFF; }
+                // time at the threshold crossing, in 1/64 of a sample
+                double frac = (thres - (s[i - 1] & 0xFFF))/static_cast<double>((s[i] & 0xFFF) - (s[i - 1] & 0xFFF));
+                uint32_t time = static_cast<uint32_t>((i - 1 + frac)*64.);
+                buf.push_back(FADC250_TYPE_WORD(7) | (ch << 23) | (npulses << 21) | (integral & 0x7FFFF));
+                buf.push_back(FADC250_TYPE_WORD(8) | (ch << 23) | (npulses << 21) | (time & 0xFFFF));
+            }
+            npulses++;
+            i = end;
+        }
+    }
+    _nevents++;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//
+// A synthetic data generator for the JLab FADC250
+// It writes slot blocks (block header, events, block trailer) as the module would, with trigger time, window raw
+// data (pedestal noise, pulses and pile-up) and pulse integral/time/raw words
+//
+
+#include <cstdint>
+#include <vector>
+#include <random>
+
+
+namespace fdec
+{
+
+// data words to write, they can be combined
+enum Fadc250GenMode : uint32_t {
+    kGenWindowRaw = 1 << 0,
+    kGenPulseIntegralTime = 1 << 1,
+    kGenPulseRaw = 1 << 2,
+};
+
+struct Fadc250GenConfig
+{
+    uint32_t mode = kGenWindowRaw;
+    uint32_t slot = 3;
+    uint32_t nchans = 16;
+    uint32_t nsamples = 100;
+    uint32_t block_level = 1;
+    // pedestal mean and noise (rms) in adc counts
+    double pedestal = 100., noise = 2.;
+    // probability of a pulse on a channel, and of a second (pile-up) pulse after it
+    double pulse_prob = 0.3, pileup_prob = 0.05;
+    // pulse height range in adc counts, rise and decay times in samples
+    double min_height = 50., max_height = 2000.;
+    double rise = 2., decay = 6.;
+    // threshold over pedestal and the samples before/after the crossing for pulse integral/raw words
+    double threshold = 20.;
+    uint32_t nsb = 3, nsa = 10;
+    // trigger interval in clock ticks (4 ns)
+    uint32_t trigger_interval = 25000;
+    uint32_t seed = 12345;
+};
+
+class Fadc250Generator
+{
+public:
+    Fadc250Generator(const Fadc250GenConfig &config = Fadc250GenConfig());
+
+    // append a block of config.block_level events to buf, returns the number of words written
+    size_t GenerateBlock(std::vector<uint32_t> &buf);
+
+    uint32_t GetNEvents() const { return _nevents; }
+    const Fadc250GenConfig &GetConfig() const { return _cfg; }
+
+private:
+    void generateEvent(std::vector<uint32_t> &buf);
+    void generateWaveform(std::vector<uint32_t> &samples);
+
+    Fadc250GenConfig _cfg;
+    std::mt19937 _rng;
+    uint32_t _nevents, _nblocks;
+    uint64_t _time;
+    std::vector<uint32_t> _samples;
+};
+
+}; // namespace fdec
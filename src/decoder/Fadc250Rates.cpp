@@ -0,0 +1,100 @@
+//
+// Streaming rates and livetime for the FADC250 data
+//
+
+#include "Fadc250Rates.h"
+#include <algorithm>
+#include <iomanip>
+
+
+using namespace fdec;
+
+#define FADC250_TIME_MASK 0xFFFFFFFFFFFFULL
+
+Fadc250Rates::Fadc250Rates(double tick_ns, int trigger_channel)
+: _tick_ns(tick_ns), _trg_ch(trigger_channel)
+{
+    Reset();
+}
+
+void Fadc250Rates::Reset()
+{
+    _has_time = false;
+    _has_scaler = false;
+    _last_time = _ticks = _nevents = 0;
+    _scaler_ticks = _scaler_time = _scaler_nevents = _nevents_since = 0;
+    _last_scalers.clear();
+    _counts.clear();
+}
+
+void Fadc250Rates::Feed(const Fadc250Event &event)
+{
+    ++_nevents;
+    ++_nevents_since;
+
+    // the 48-bit counter wraps in ~13 days at 250 MHz, differences are taken modulo 2^48
+    uint64_t time = event.time & FADC250_TIME_MASK;
+    if (_has_time) {
+        _ticks += (time - _last_time) & FADC250_TIME_MASK;
+    }
+    _last_time = time;
+    _has_time = true;
+
+    if (event.scalers.empty()) {
+        return;
+    }
+
+    if (_has_scaler) {
+        size_t n = std::min(event.scalers.size(), _last_scalers.size());
+        for (size_t i = 0; i < n; ++i) {
+            // unsigned subtraction handles the 32-bit wrapping
+            _counts[i] += static_cast<uint32_t>(event.scalers[i] - _last_scalers[i]);
+        }
+        _scaler_ticks += (time - _scaler_time) & FADC250_TIME_MASK;
+        _scaler_nevents += _nevents_since;
+    } else {
+        _counts.assign(event.scalers.size(), 0);
+    }
+    _last_scalers.assign(event.scalers.begin(), event.scalers.end());
+    _scaler_time = time;
+    _nevents_since = 0;
+    _has_scaler = true;
+}
+
+double Fadc250Rates::GetEventRate() const
+{
+    double dt = GetElapsed();
+    // n events span n - 1 intervals
+    return (dt > 0.) ? (_nevents - 1)/dt : 0.;
+}
+
+double Fadc250Rates::GetRate(size_t i) const
+{
+    double dt = GetScalerTime();
+    return (dt > 0.) ? GetCounts(i)/dt : 0.;
+}
+
+double Fadc250Rates::GetLivetime() const
+{
+    if ((_trg_ch < 0) || (static_cast<size_t>(_trg_ch) >= _counts.size()) || !_counts[_trg_ch]) {
+        return -1.;
+    }
+    return static_cast<double>(_scaler_nevents)/static_cast<double>(_counts[_trg_ch]);
+}
+
+void Fadc250Rates::PrintSummary(std::ostream &os) const
+{
+    os << "Events: " << _nevents << ", elapsed " << GetElapsed() << " s, rate " << GetEventRate() << " Hz\n";
+    if (!_has_scaler) {
+        os << "No scaler data.\n";
+        return;
+    }
+    os << "Scalers over " << GetScalerTime() << " s:\n";
+    for (size_t i = 0; i < _counts.size(); ++i) {
+        os << std::setw(4) << i << std::setw(14) << _counts[i] << std::setw(14) << GetRate(i) << " Hz\n";
+    }
+    double lt = GetLivetime();
+    if (lt >= 0.) {
+        os << "Livetime: " << lt*100. << "%\n";
+    }
+}
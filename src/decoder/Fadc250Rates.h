@@ -0,0 +1,54 @@
+#pragma once
+
+//
+// Streaming rates and livetime from the FADC250 trigger time and scaler counters
+// It keeps running totals only, so it can be fed from the decoding pass
+//
+// Trigger time is the 48-bit counter of the module clock (4 ns for 250 MHz)
+// Scaler counters are cumulative 32-bit counts, their differences between two scaler reads are accumulated
+// Livetime is the accepted events over the counts on a scaler channel that takes the trigger input (if any)
+//
+
+#include "Fadc250Decoder.h"
+
+
+namespace fdec
+{
+
+class Fadc250Rates
+{
+public:
+    Fadc250Rates(double tick_ns = 4., int trigger_channel = -1);
+
+    void Feed(const Fadc250Event &event);
+    void Reset();
+
+    // events and time from the trigger time
+    uint64_t GetNEvents() const { return _nevents; }
+    double GetElapsed() const { return _ticks*_tick_ns*1e-9; }
+    double GetEventRate() const;
+
+    // scaler counts and rates, averaged over the time between the first and the last scaler reads
+    size_t GetNScalers() const { return _counts.size(); }
+    uint64_t GetCounts(size_t i) const { return (i < _counts.size()) ? _counts[i] : 0; }
+    double GetScalerTime() const { return _scaler_ticks*_tick_ns*1e-9; }
+    double GetRate(size_t i) const;
+
+    // accepted events over triggers, -1 if it is not available
+    double GetLivetime() const;
+
+    void PrintSummary(std::ostream &os = std::cout) const;
+
+private:
+    double _tick_ns;
+    int _trg_ch;
+
+    bool _has_time, _has_scaler;
+    uint64_t _last_time, _ticks, _nevents;
+    // scaler states
+    uint64_t _scaler_ticks, _scaler_time, _scaler_nevents, _nevents_since;
+    std::vector<uint32_t> _last_scalers;
+    std::vector<uint64_t> _counts;
+};
+
+}; // namespace fdec
@@ -0,0 +1,106 @@
+#pragma once
+
+//
+// Unpacking of the FADC250 raw sample words (window raw and pulse raw data)
+// The SIMD versions are selected at run time, they give the same samples as the scalar one
+//
+
+#include <cstdint>
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FADC250_UNPACK_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace fdec
+{
+
+// unpack the 13-bit samples of a raw data block starting at buf[beg + 1] into out (capacity >= max_samples + 1)
+// it stops at a new type word, when max_samples are filled, or at the end of the buffer
+// returns the number of words consumed, nsamples is updated
+inline uint32_t unpack_words_scalar(const uint32_t *buf, size_t beg, size_t end, uint32_t *out,
+                                    size_t max_samples, size_t &nsamples, uint32_t nwords = 0)
+{
+    for (size_t i = beg + 1 + nwords; (nsamples < max_samples) && (i < end); ++i, ++nwords) {
+        auto data = buf[i];
+        // finished
+        if ((data & 0x80000000) && nwords > 0) {
+            return nwords;
+        }
+
+        if (!(data & 0x20000000)) {
+            out[nsamples++] = (data >> 16) & 0x1FFF;
+        }
+        if (!(data & 0x2000)) {
+            out[nsamples++] = (data & 0x1FFF);
+        }
+    }
+    return nwords;
+}
+
+// type bit and the two "not valid" bits, none of them is set in a plain sample word
+#define FADC250_SAMPLE_FLAGS 0xA0002000
+
+#ifdef FADC250_UNPACK_SIMD
+// 4 words (8 samples) per iteration, blocks with any flag go to the scalar loop
+__attribute__((target("sse4.1")))
+inline uint32_t unpack_words_sse4(const uint32_t *buf, size_t beg, size_t end, uint32_t *out,
+                                  size_t max_samples, size_t &nsamples)
+{
+    const __m128i flags = _mm_set1_epi32(FADC250_SAMPLE_FLAGS);
+    const __m128i smask = _mm_set1_epi32(0x1FFF);
+    uint32_t nwords = 0;
+    while ((nsamples + 8 <= max_samples) && (beg + 1 + nwords + 4 <= end)) {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + beg + 1 + nwords));
+        if (!_mm_testz_si128(w, flags)) { break; }
+        __m128i hi = _mm_and_si128(_mm_srli_epi32(w, 16), smask);
+        __m128i lo = _mm_and_si128(w, smask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + nsamples), _mm_unpacklo_epi32(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + nsamples + 4), _mm_unpackhi_epi32(hi, lo));
+        nsamples += 8;
+        nwords += 4;
+    }
+    return unpack_words_scalar(buf, beg, end, out, max_samples, nsamples, nwords);
+}
+
+// 8 words (16 samples) per iteration
+__attribute__((target("avx2")))
+inline uint32_t unpack_words_avx2(const uint32_t *buf, size_t beg, size_t end, uint32_t *out,
+                                  size_t max_samples, size_t &nsamples)
+{
+    const __m256i flags = _mm256_set1_epi32(FADC250_SAMPLE_FLAGS);
+    const __m256i smask = _mm256_set1_epi32(0x1FFF);
+    uint32_t nwords = 0;
+    while ((nsamples + 16 <= max_samples) && (beg + 1 + nwords + 8 <= end)) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf + beg + 1 + nwords));
+        if (!_mm256_testz_si256(w, flags)) { break; }
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi32(w, 16), smask);
+        __m256i lo = _mm256_and_si256(w, smask);
+        // in-lane interleave, then put the lanes back in order
+        __m256i a = _mm256_unpacklo_epi32(hi, lo), b = _mm256_unpackhi_epi32(hi, lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + nsamples), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + nsamples + 8), _mm256_permute2x128_si256(a, b, 0x31));
+        nsamples += 16;
+        nwords += 8;
+    }
+    return unpack_words_scalar(buf, beg, end, out, max_samples, nsamples, nwords);
+}
+#endif
+
+inline uint32_t unpack_words(const uint32_t *buf, size_t beg, size_t end, uint32_t *out,
+                             size_t max_samples, size_t &nsamples)
+{
+#ifdef FADC250_UNPACK_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return unpack_words_avx2(buf, beg, end, out, max_samples, nsamples);
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return unpack_words_sse4(buf, beg, end, out, max_samples, nsamples);
+    }
+#endif
+    return unpack_words_scalar(buf, beg, end, out, max_samples, nsamples);
+}
+
+}; // namespace fdec
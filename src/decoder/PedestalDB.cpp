@@ -0,0 +1,36 @@
+//
+// Per-channel pedestal database
+//
+
+#include "PedestalDB.h"
+#include <iomanip>
+
+
+using namespace fdec;
+
+#define PEDESTAL_HEADER "# crate  slot  channel  mean  rms"
+
+inline void write_pedestal(std::ostream &os, uint32_t crate, uint32_t slot, uint32_t channel, const Pedestal &ped)
+{
+    os << std::setw(7) << crate << std::setw(6) << slot << std::setw(9) << channel
+       << std::fixed << std::setprecision(4) << std::setw(12) << ped.mean << std::setw(10) << ped.err
+       << std::defaultfloat << std::endl;
+}
+
+bool PedestalDB::Load(const std::string &path)
+{
+    return load(path, "pedestal", [] (std::istream &is, Pedestal &ped) {
+        return static_cast<bool>(is >> ped.mean >> ped.err);
+    });
+}
+
+bool PedestalDB::Save(const std::string &path) const
+{
+    return save(path, "pedestal", PEDESTAL_HEADER, write_pedestal);
+}
+
+// sorted by crate, slot and channel
+void PedestalDB::Print(std::ostream &os) const
+{
+    print(os, PEDESTAL_HEADER, write_pedestal);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+//
+// Per-channel pedestals (mean and rms in adc counts) addressed by crate, slot and channel
+// The pedestals are stable over a run, so a stored one can replace the pedestal search of the analyzer (see
+// Analyzer::Analyze with a known pedestal)
+//
+// File format, one channel per line, "#" starts a comment:
+// crate  slot  channel  mean  rms
+//
+
+#include "ChannelDB.h"
+
+
+namespace fdec
+{
+
+class PedestalDB : public ChannelDB<Pedestal>
+{
+public:
+    // returns false if the file cannot be opened, bad lines are reported and skipped
+    bool Load(const std::string &path);
+    bool Save(const std::string &path) const;
+
+    void Print(std::ostream &os = std::cout) const;
+};
+
+}; // namespace fdec
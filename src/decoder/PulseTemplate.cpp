@@ -0,0 +1,188 @@
+//
+// Pulse templates and the template fit
+//
+
+#include "PulseTemplate.h"
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+
+using namespace fdec;
+
+PulseTemplate::PulseTemplate(size_t nbefore, size_t nafter, size_t nsub)
+: _nsub(std::max(nsub, size_t(1))), _nbefore(nbefore), _npulses(0), _first(-static_cast<double>(nbefore))
+{
+    _sums.assign((nbefore + nafter)*_nsub + 1, 0.);
+    _counts.assign(_sums.size(), 0);
+}
+
+// each sample goes to the fine bin of its time relative to the pulse time
+void PulseTemplate::Fill(const uint32_t *samples, size_t nsamples, double ped, double amp, double time)
+{
+    if ((amp <= 0.) || _sums.empty()) { return; }
+
+    double first = -static_cast<double>(_nbefore), last = first + (_sums.size() - 1)/static_cast<double>(_nsub);
+    long beg = std::max(0L, static_cast<long>(std::ceil(time + first)));
+    long end = std::min(static_cast<long>(nsamples) - 1, static_cast<long>(std::floor(time + last)));
+    for (long i = beg; i <= end; ++i) {
+        long bin = std::lround((i - time - first)*_nsub);
+        if ((bin < 0) || (bin >= static_cast<long>(_sums.size()))) { continue; }
+        _sums[bin] += (samples[i] - ped)/amp;
+        _counts[bin]++;
+    }
+    _npulses++;
+}
+
+bool PulseTemplate::Finish()
+{
+    size_t n = _sums.size();
+    std::vector<double> vals(n, 0.);
+    std::vector<size_t> filled;
+    for (size_t i = 0; i < n; ++i) {
+        if (_counts[i]) {
+            vals[i] = _sums[i]/_counts[i];
+            filled.push_back(i);
+        }
+    }
+    if (filled.empty()) { return false; }
+
+    // the empty bins are interpolated between the filled ones, the ones beyond take the nearest
+    for (size_t i = 0; i < filled.front(); ++i) { vals[i] = vals[filled.front()]; }
+    for (size_t i = filled.back() + 1; i < n; ++i) { vals[i] = vals[filled.back()]; }
+    for (size_t k = 1; k < filled.size(); ++k) {
+        size_t b0 = filled[k - 1], b1 = filled[k];
+        for (size_t i = b0 + 1; i < b1; ++i) {
+            vals[i] = vals[b0] + (vals[b1] - vals[b0])*(i - b0)/static_cast<double>(b1 - b0);
+        }
+    }
+
+    // the maximum is at t = 0 with the value 1
+    size_t imax = std::max_element(vals.begin(), vals.end()) - vals.begin();
+    if (vals[imax] <= 0.) { return false; }
+    double vmax = vals[imax];
+    for (auto &val : vals) { val /= vmax; }
+    SetValues(_nsub, -static_cast<double>(imax)/_nsub, vals);
+
+    // no more building
+    std::vector<double>().swap(_sums);
+    std::vector<uint32_t>().swap(_counts);
+    return true;
+}
+
+void PulseTemplate::SetValues(size_t nsub, double first, const std::vector<double> &values)
+{
+    _nsub = std::max(nsub, size_t(1));
+    _first = first;
+    _values = values;
+
+    // derivatives from the central differences, one-sided at the edges
+    size_t n = _values.size();
+    _derivs.assign(n, 0.);
+    for (size_t i = 0; (n > 1) && (i < n); ++i) {
+        size_t i0 = (i > 0) ? i - 1 : 0, i1 = std::min(i + 1, n - 1);
+        _derivs[i] = (_values[i1] - _values[i0])*_nsub/static_cast<double>(i1 - i0);
+    }
+}
+
+void PulseTemplate::Eval(double t, double &val, double &deriv) const
+{
+    double u = (t - _first)*_nsub;
+    if ((_values.size() < 2) || (u < 0.) || (u >= _values.size() - 1)) {
+        val = deriv = 0.;
+        return;
+    }
+    size_t i = static_cast<size_t>(u);
+    double frac = u - i;
+    val = _values[i] + frac*(_values[i + 1] - _values[i]);
+    deriv = _derivs[i] + frac*(_derivs[i + 1] - _derivs[i]);
+}
+
+// Gauss-Newton on (amp, time) for the model ped + amp*shape(i - time), no ROOT fitting
+bool PulseTemplate::Fit(const uint32_t *samples, size_t nsamples, double ped, uint32_t pos, uint32_t left,
+                        uint32_t right, double &amp, double &time, size_t niters) const
+{
+    if (Empty() || (pos >= nsamples)) { return false; }
+
+    // start from the parabola through the maximum and its neighbors
+    amp = samples[pos] - ped;
+    time = pos;
+    if (amp <= 0.) { return false; }
+    if ((pos > 0) && (pos + 1 < nsamples)) {
+        double y0 = samples[pos - 1] - ped, y2 = samples[pos + 1] - ped;
+        double curv = y0 - 2.*amp + y2;
+        if (curv < 0.) { time += std::max(-0.5, std::min(0.5, 0.5*(y0 - y2)/curv)); }
+    }
+
+    long lo = left, hi = std::min(static_cast<long>(right), static_cast<long>(nsamples) - 1);
+    for (size_t iter = 0; iter < niters; ++iter) {
+        long beg = std::max(lo, static_cast<long>(std::ceil(time + _first)));
+        long end = std::min(hi, static_cast<long>(std::floor(time + GetLast())));
+        double saa = 0., sat = 0., stt = 0., sar = 0., str = 0.;
+        for (long i = beg; i <= end; ++i) {
+            double val, deriv;
+            Eval(i - time, val, deriv);
+            double res = (samples[i] - ped) - amp*val;
+            // derivatives of the model over amp and time
+            double ja = val, jt = -amp*deriv;
+            saa += ja*ja;
+            sat += ja*jt;
+            stt += jt*jt;
+            sar += ja*res;
+            str += jt*res;
+        }
+        double det = saa*stt - sat*sat;
+        if (det <= 0.) { return false; }
+        amp += (stt*sar - sat*str)/det;
+        time += std::max(-1., std::min(1., (saa*str - sat*sar)/det));
+    }
+    return (amp > 0.) && (std::abs(time - pos) < 2.);
+}
+
+bool PulseTemplate::LeadingEdge(const uint32_t *samples, size_t nsamples, double ped, uint32_t pos, double &time)
+{
+    if (pos >= nsamples) { return false; }
+
+    double half = 0.5*(samples[pos] - ped);
+    if (half <= 0.) { return false; }
+    for (uint32_t i = pos; i > 0; --i) {
+        double y0 = samples[i - 1] - ped, y1 = samples[i] - ped;
+        if ((y0 < half) && (y1 >= half)) {
+            time = (i - 1) + (half - y0)/(y1 - y0);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool PulseTemplateDB::Load(const std::string &path)
+{
+    return load(path, "pulse template", [] (std::istream &is, PulseTemplate &tmpl) {
+        size_t nsub, npoints;
+        double first;
+        if (!(is >> nsub >> first >> npoints) || (nsub == 0) || (npoints < 2)) {
+            return false;
+        }
+        std::vector<double> values(npoints);
+        for (auto &val : values) {
+            if (!(is >> val)) { return false; }
+        }
+        tmpl.SetValues(nsub, first, values);
+        return true;
+    });
+}
+
+// sorted by crate, slot and channel
+bool PulseTemplateDB::Save(const std::string &path) const
+{
+    return save(path, "pulse template", "# crate  slot  channel  nsub  first  npoints  values...",
+                [] (std::ostream &os, uint32_t crate, uint32_t slot, uint32_t channel, const PulseTemplate &tmpl) {
+        auto &vals = tmpl.GetValues();
+        os << crate << " " << slot << " " << channel << " " << tmpl.GetNSub() << " "
+           << std::setprecision(8) << tmpl.GetFirst() << " " << vals.size();
+        os << std::setprecision(6);
+        for (auto val : vals) { os << " " << val; }
+        os << std::endl;
+    });
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+//
+// Pulse templates for the sub-sample timing of the FADC250 peaks
+// A template is the pulse shape normalized to its maximum (1 at t = 0), tabulated at 1/nsub of a sample
+// It is built from the pulses in data, they are aligned by their times and the random phases to the sampling clock
+// fill the fine bins, the first pass can align them by the leading edge (LeadingEdge) and the next ones by the fit
+// A peak is fitted with amplitude*shape(i - time) in a fixed number of Gauss-Newton iterations on the lookup tables
+//
+// File format (PulseTemplateDB), one channel per line, "#" starts a comment:
+// crate  slot  channel  nsub  first  npoints  values...
+// first is the time of the first point (in samples) relative to the maximum
+//
+
+#include "ChannelDB.h"
+#include <string>
+#include <vector>
+
+
+namespace fdec
+{
+
+class PulseTemplate
+{
+public:
+    // the building range is [-nbefore, nafter] samples around the pulse times
+    PulseTemplate(size_t nbefore = 4, size_t nafter = 12, size_t nsub = 32);
+
+    // building, samples are the raw samples, the pulse is ped + amp*shape(i - time)
+    void Fill(const uint32_t *samples, size_t nsamples, double ped, double amp, double time);
+    // normalize the filled pulses to the lookup tables, the empty fine bins are interpolated
+    // it returns false if nothing is filled
+    bool Finish();
+    size_t GetNPulses() const { return _npulses; }
+
+    // tabulated shape and its derivative (linear interpolation), 0 outside the table
+    void Eval(double t, double &val, double &deriv) const;
+    double Eval(double t) const { double val, deriv; Eval(t, val, deriv); return val; }
+
+    // fit the peak at the sample pos, amp and time (in samples) are the results, the samples are fitted within the
+    // template range and [left, right], it returns false if the fit does not converge around pos
+    bool Fit(const uint32_t *samples, size_t nsamples, double ped, uint32_t pos, uint32_t left, uint32_t right,
+             double &amp, double &time, size_t niters = 4) const;
+
+    // time of the half-height crossing on the leading edge of the peak at pos (linear interpolation), for the
+    // alignment without a template, it returns false if there is no crossing
+    static bool LeadingEdge(const uint32_t *samples, size_t nsamples, double ped, uint32_t pos, double &time);
+
+    bool Empty() const { return _values.empty(); }
+    size_t GetNSub() const { return _nsub; }
+    double GetFirst() const { return _first; }
+    double GetLast() const { return _first + (_values.size() - 1)/static_cast<double>(_nsub); }
+    const std::vector<double> &GetValues() const { return _values; }
+    // set the lookup table directly (from a file)
+    void SetValues(size_t nsub, double first, const std::vector<double> &values);
+
+private:
+    size_t _nsub, _nbefore, _npulses;
+    double _first;
+    std::vector<double> _values, _derivs;
+    // building sums
+    std::vector<double> _sums;
+    std::vector<uint32_t> _counts;
+};
+
+// per-channel templates addressed by crate, slot and channel
+class PulseTemplateDB : public ChannelDB<PulseTemplate>
+{
+public:
+    // returns false if the file cannot be opened, bad lines are reported and skipped
+    bool Load(const std::string &path);
+    bool Save(const std::string &path) const;
+};
+
+}; // namespace fdec
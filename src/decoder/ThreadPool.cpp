@@ -0,0 +1,85 @@
+//
+// A minimal pool of worker threads
+//
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+
+using namespace fdec;
+
+ThreadPool::ThreadPool(size_t nthreads)
+: _func(nullptr), _njobs(0), _nbusy(0), _next(0), _generation(0), _stop(false)
+{
+    if (!nthreads) {
+        nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (size_t i = 1; i < nthreads; ++i) {
+        _workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv_start.notify_all();
+    for (auto &worker : _workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Run(size_t njobs, const std::function<void(size_t, size_t)> &func)
+{
+    if (!njobs) { return; }
+
+    // nothing to share
+    if (_workers.empty() || (njobs == 1)) {
+        for (size_t i = 0; i < njobs; ++i) { func(i, 0); }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _func = &func;
+        _njobs = njobs;
+        _next = 0;
+        _nbusy = _workers.size();
+        _generation++;
+    }
+    _cv_start.notify_all();
+
+    runJobs(0);
+
+    // every worker finishes its part of this generation before the next Run
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv_done.wait(lock, [this] () { return _nbusy == 0; });
+    _func = nullptr;
+}
+
+void ThreadPool::work(size_t thread)
+{
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv_start.wait(lock, [this, generation] () { return _stop || (_generation != generation); });
+            if (_stop) { return; }
+            generation = _generation;
+        }
+
+        runJobs(thread);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_nbusy == 0) { _cv_done.notify_one(); }
+    }
+}
+
+void ThreadPool::runJobs(size_t thread)
+{
+    for (size_t i = _next++; i < _njobs; i = _next++) {
+        (*_func)(i, thread);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+//
+// A minimal pool of worker threads for splitting a batch of jobs
+// The calling thread also takes jobs, so a pool of size 1 runs everything in place without any thread
+//
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+namespace fdec
+{
+
+class ThreadPool
+{
+public:
+    // nthreads includes the calling thread, 0 uses the hardware concurrency
+    ThreadPool(size_t nthreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator =(const ThreadPool &) = delete;
+
+    size_t Size() const { return _workers.size() + 1; }
+
+    // run func(job, thread) for all the jobs in [0, njobs) and wait for them, thread is in [0, Size())
+    void Run(size_t njobs, const std::function<void(size_t, size_t)> &func);
+
+private:
+    void work(size_t thread);
+    void runJobs(size_t thread);
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _cv_start, _cv_done;
+    const std::function<void(size_t, size_t)> *_func;
+    size_t _njobs, _nbusy;
+    std::atomic<size_t> _next;
+    uint64_t _generation;
+    bool _stop;
+};
+
+}; // namespace fdec
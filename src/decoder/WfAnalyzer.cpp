@@ -1,18 +1,40 @@
-#include "TSpectrum.h"
 #include "WfAnalyzer.h"
+#include "PulseTemplate.h"
 #include <iostream>
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define WFANALYZER_SIMD
+#include <immintrin.h>
+#endif
+
+// longest kernel with precomputed weights, longer ones use the plain loop
+#define SMOOTH_MAX_RES 64
+// rounding margin (adc counts) of the sliding pedestal window sums, the windows within it from the flatness cut or
+// the current pedestal are computed again from scratch
+#define PED_SUM_TOL 1e-3
+
 
 using namespace fdec;
 
 // constructor
-Analyzer::Analyzer(size_t res, double thres, size_t npeds, double ped_flat, uint32_t overflow, double clk)
-: _thres(thres), _res(res), _ped_flat(ped_flat), _npeds(npeds), _overflow(overflow), _clk(clk)
+template<typename F>
+AnalyzerT<F>::AnalyzerT(size_t res, double thres, size_t npeds, double ped_flat, uint32_t overflow, double clk)
+: _thres(thres), _res(res), _ped_flat(ped_flat), _ped_shift(2.0), _npeds(npeds), _overflow(overflow), _clk(clk),
+  _zero_sup(false)
 {
     // place holder
 }
 
-void Analyzer::Analyze(Fadc250Data &data) const
+// a workspace per thread for the calls without one
+template<typename F>
+void AnalyzerT<F>::Analyze(Fadc250Data &data) const
+{
+    static thread_local Workspace ws;
+    Analyze(data, ws);
+}
+
+template<typename F>
+void AnalyzerT<F>::Analyze(Fadc250Data &data, Workspace &ws) const
 {
     uint32_t *samples = &data.raw[0];
     size_t nsamples = data.raw.size();
@@ -20,40 +42,111 @@ void Analyzer::Analyze(Fadc250Data &data) const
 
     data.peaks.clear();
 
-    auto buffer = SmoothSpectrum(samples, nsamples, _res);
+    // no signal
+    if (IsEmpty(samples, nsamples)) {
+        _calc_mean_err(data.ped.mean, data.ped.err, samples, nsamples);
+        return;
+    }
+
+    auto &buffer = ws.buffer;
+    SmoothSpectrum(samples, nsamples, _res, buffer, ws.input);
 
     // search local maxima
-    auto candidates = SearchMaxima(buffer, _thres);
+    auto &candidates = ws.candidates;
+    SearchMaxima(buffer, _thres, candidates);
 
     // get pedestal
-    data.ped = FindPedestal(buffer, candidates);
+    data.ped = FindPedestal(buffer, candidates, ws.ybuf, ws.work);
 
     // get final results
+    fillPeaks(samples, nsamples, buffer, data.ped, candidates, data.peaks);
+
+    /*
+    std::sort(peaks.begin(), peaks.end(),
+                [] (const Peak &p1, const Peak &p2) { return p1.height > p2.height; });
+    */
+    return;
+}
+
+template<typename F>
+bool AnalyzerT<F>::Analyze(Fadc250Data &data, const Pedestal &ped, Workspace &ws) const
+{
+    uint32_t *samples = &data.raw[0];
+    size_t nsamples = data.raw.size();
+    if (!nsamples) { return false; }
+
+    data.peaks.clear();
+
+    if (IsEmpty(samples, nsamples)) {
+        _calc_mean_err(data.ped.mean, data.ped.err, samples, nsamples);
+        if (std::abs(data.ped.mean - ped.mean) >= _ped_shift) { return false; }
+        data.ped = ped;
+        return true;
+    }
+
+    auto &buffer = ws.buffer;
+    SmoothSpectrum(samples, nsamples, _res, buffer, ws.input);
+
+    auto &candidates = ws.candidates;
+    SearchMaxima(buffer, _thres, candidates);
+
+    // fall back to the pedestal search if the baseline has shifted
+    bool fixed = CheckPedestal(buffer, ped);
+    data.ped = fixed ? ped : FindPedestal(buffer, candidates, ws.ybuf, ws.work);
+
+    fillPeaks(samples, nsamples, buffer, data.ped, candidates, data.peaks);
+    return fixed;
+}
+
+
+template<typename F>
+size_t AnalyzerT<F>::FitPeaks(Fadc250Data &data, const PulseTemplate &tmpl) const
+{
+    size_t nfit = 0;
+    for (auto &peak : data.peaks) {
+        double amp, time;
+        if (peak.overflow || (peak.height <= 0.) ||
+            !tmpl.Fit(data.raw.data(), data.raw.size(), data.ped.mean, peak.pos, peak.left, peak.right, amp, time)) {
+            continue;
+        }
+        peak.height = amp;
+        peak.time = time*1e3/_clk;
+        nfit++;
+    }
+    return nfit;
+}
+
+
+// pedestal subtraction, integration and the sample peak for the candidates, the good ones are added to peaks
+template<typename F>
+void AnalyzerT<F>::fillPeaks(const uint32_t *samples, size_t nsamples, const std::vector<F> &buffer,
+                             const Pedestal &ped, std::vector<Peak> &candidates, std::vector<Peak> &peaks) const
+{
     for (auto &peak : candidates) {
         // pedestal subtraction
-        double peak_height = buffer[peak.pos] - data.ped.mean;
+        double peak_height = buffer[peak.pos] - ped.mean;
         // wrong baselin in the rough candidtes finding, below threshold, or not statistically significant
         if ((peak_height * peak.height < 0.) ||
             (std::abs(peak_height) < _thres) ||
-            (std::abs(peak_height) < 3.0*data.ped.err)) {
+            (std::abs(peak_height) < 3.0*ped.err)) {
             continue;
         }
         peak.height = peak_height;
 
         // integrate it over the peak range
-        peak.integral = buffer[peak.pos] - data.ped.mean;
+        peak.integral = buffer[peak.pos] - ped.mean;
         // i may go below 0
         for (int i = peak.pos - 1; i >= static_cast<int>(peak.left); --i) {
-            double val = buffer[i] - data.ped.mean;
+            double val = buffer[i] - ped.mean;
             // stop when it touches or acrosses the baseline
-            if (std::abs(val) < data.ped.err || val * peak.height < 0.) {
+            if (std::abs(val) < ped.err || val * peak.height < 0.) {
                 peak.left = i; break;
             }
             peak.integral += val;
         }
         for (size_t i = peak.pos + 1; i <= peak.right; ++i) {
-            double val = buffer[i] - data.ped.mean;
-            if (std::abs(val) < data.ped.err || val * peak.height < 0.) {
+            double val = buffer[i] - ped.mean;
+            if (std::abs(val) < ped.err || val * peak.height < 0.) {
                 peak.right = i; break;
             }
             peak.integral += val;
@@ -61,7 +154,7 @@ void Analyzer::Analyze(Fadc250Data &data) const
 
         // determine the real sample peak
         uint32_t sample_pos = peak.pos;
-        peak.height = samples[sample_pos] - data.ped.mean;
+        peak.height = samples[sample_pos] - ped.mean;
         auto update_peak = [] (Peak &peak, double val, uint32_t pos) {
             if (std::abs(val) > std::abs(peak.height)) {
                 peak.pos = pos;
@@ -70,10 +163,10 @@ void Analyzer::Analyze(Fadc250Data &data) const
         };
         for (size_t i = 1; i < _res; ++i) {
             if (sample_pos > i) {
-                update_peak(peak, samples[sample_pos - i] - data.ped.mean, sample_pos - i);
+                update_peak(peak, samples[sample_pos - i] - ped.mean, sample_pos - i);
             }
             if (sample_pos + i < nsamples) {
-                update_peak(peak, samples[sample_pos + i] - data.ped.mean, sample_pos + i);
+                update_peak(peak, samples[sample_pos + i] - ped.mean, sample_pos + i);
             }
         }
 
@@ -82,19 +175,14 @@ void Analyzer::Analyze(Fadc250Data &data) const
         // overflow check
         peak.overflow = samples[peak.pos] >= _overflow;
         // fill to results
-        data.peaks.emplace_back(peak);
+        peaks.emplace_back(peak);
     }
-
-    /*
-    std::sort(peaks.begin(), peaks.end(),
-                [] (const Peak &p1, const Peak &p2) { return p1.height > p2.height; });
-    */
-    return;
 }
 
 
 // analyze waveform
-Fadc250Data Analyzer::Analyze(const uint32_t *samples, size_t nsamples) const
+template<typename F>
+Fadc250Data AnalyzerT<F>::Analyze(const uint32_t *samples, size_t nsamples) const
 {
     Fadc250Data data;
 
@@ -106,8 +194,491 @@ Fadc250Data Analyzer::Analyze(const uint32_t *samples, size_t nsamples) const
     return data;
 }
 
+
+// mean and rms of a window computed from scratch, the same operations as _calc_mean_err, x[i*stride] are the samples
+template<typename T>
+inline void window_mean_err(const T *x, size_t stride, size_t n, double &mean, double &err)
+{
+    mean = 0.;
+    err = 0.;
+    for (size_t i = 0; i < n; ++i) {
+        mean += x[i*stride];
+    }
+    mean /= static_cast<double>(n);
+    for (size_t i = 0; i < n; ++i) {
+        err += (x[i*stride] - mean)*(x[i*stride] - mean);
+    }
+    err = std::sqrt(err/static_cast<double>(n));
+}
+
+// pedestal window selection: the lowest flat window, the first one wins a tie
+// the sliding sums order the windows, the exact values (from scratch) decide when the sums are too close to the cuts
+// or to the selected window to tell, and they are computed for the selected window at the end, so the selection and
+// the result are the same as computing every window from scratch
+struct PedWindowSelect
+{
+    double flat, max_mean, bound;
+    size_t best;
+    bool found, exact;
+    Pedestal ped;
+
+    PedWindowSelect(double f = 1., double mm = 0.) { Reset(f, mm); }
+
+    void Reset(double f, double mm)
+    {
+        flat = f;
+        max_mean = mm;
+        bound = mm;
+        best = 0;
+        found = exact = false;
+    }
+
+    // a window may be selected if it passes this quick check on its sums
+    bool Candidate(double mean, double err) const
+    {
+        return (err < flat + PED_SUM_TOL) && (mean < bound + PED_SUM_TOL);
+    }
+
+    // window i with the mean and rms from the sums
+    template<typename T>
+    void Add(const T *x, size_t stride, size_t n, size_t i, double mean, double err)
+    {
+        if (!Candidate(mean, err)) { return; }
+
+        // clearly flat and lower
+        if ((err < flat - PED_SUM_TOL) && (mean < bound - PED_SUM_TOL)) {
+            select(i, mean);
+            exact = false;
+            return;
+        }
+
+        Pedestal win;
+        window_mean_err(x + i*stride, stride, n, win.mean, win.err);
+        if (!(win.err < flat) || !(win.mean < max_mean)) { return; }
+        if (found) {
+            if (!exact) { window_mean_err(x + best*stride, stride, n, ped.mean, ped.err); }
+            if (!(win.mean < ped.mean)) {
+                exact = true;
+                return;
+            }
+        }
+        select(i, mean);
+        ped = win;
+        exact = true;
+    }
+
+    // returns false if there is no flat window
+    template<typename T>
+    bool Result(const T *x, size_t stride, size_t n, Pedestal &res)
+    {
+        if (!found) { return false; }
+        if (!exact) {
+            window_mean_err(x + best*stride, stride, n, ped.mean, ped.err);
+            exact = true;
+        }
+        res = ped;
+        return true;
+    }
+
+private:
+    void select(size_t i, double mean)
+    {
+        best = i;
+        bound = mean;
+        found = true;
+    }
+};
+
+#ifdef WFANALYZER_SIMD
+// the lane kernels below repeat the operations of smooth_sample and FindPedestal on each lane in the same order,
+// so the batch results are identical to the ones of one waveform at a time
+
+// smoothing of 4 interleaved waveforms, w are the kernel weights
+__attribute__((target("avx2")))
+inline void smooth_lanes_avx2(const double *x, double *out, size_t n, const double *w, size_t res)
+{
+    for (size_t i = 0; i < n; ++i) {
+        __m256d val = _mm256_loadu_pd(x + i*4);
+        double weights = 1.;
+        for (size_t j = 1; j < res; ++j) {
+            if (j >= i || j + i >= n) { continue; }
+            __m256d nb = _mm256_add_pd(_mm256_loadu_pd(x + (i - j)*4), _mm256_loadu_pd(x + (i + j)*4));
+            val = _mm256_add_pd(val, _mm256_mul_pd(_mm256_set1_pd(w[j]), nb));
+            weights += 2*w[j];
+        }
+        _mm256_storeu_pd(out + i*4, _mm256_div_pd(val, _mm256_set1_pd(weights)));
+    }
+}
+
+// pedestal windows of 4 interleaved waveforms, with the sliding sums and the window selection of FindPedestal
+// the lanes are x[i*stride + k], ped[k] and err[k] are the selected window of lane k, found[k] tells if there is one
+__attribute__((target("avx2")))
+inline void ped_lanes_avx2(const double *x, size_t stride, size_t n, size_t ntrails, double flat, double max_mean,
+                           double *ped, double *err, bool *found)
+{
+    const __m256d shift = _mm256_loadu_pd(x), zero = _mm256_setzero_pd(), nt = _mm256_set1_pd(ntrails);
+    const __m256d vflat = _mm256_set1_pd(flat + PED_SUM_TOL), vtol = _mm256_set1_pd(PED_SUM_TOL);
+    __m256d sum = zero, sum2 = zero;
+    PedWindowSelect sel[4];
+    double bounds[4], means[4], errs[4];
+    for (int k = 0; k < 4; ++k) {
+        sel[k].Reset(flat, max_mean);
+        bounds[k] = max_mean;
+    }
+    for (size_t i = 0; i < ntrails; ++i) {
+        __m256d val = _mm256_sub_pd(_mm256_loadu_pd(x + i*stride), shift);
+        sum = _mm256_add_pd(sum, val);
+        sum2 = _mm256_add_pd(sum2, _mm256_mul_pd(val, val));
+    }
+    for (size_t i = 0; i <= n - ntrails; ++i) {
+        if (i > 0) {
+            __m256d v0 = _mm256_sub_pd(_mm256_loadu_pd(x + (i - 1)*stride), shift);
+            __m256d v1 = _mm256_sub_pd(_mm256_loadu_pd(x + (i + ntrails - 1)*stride), shift);
+            sum = _mm256_add_pd(sum, _mm256_sub_pd(v1, v0));
+            sum2 = _mm256_add_pd(sum2, _mm256_sub_pd(_mm256_mul_pd(v1, v1), _mm256_mul_pd(v0, v0)));
+        }
+        __m256d mean = _mm256_div_pd(sum, nt);
+        // max_pd(0, v) is (0 > v) ? 0 : v, the same as std::max(v, 0.)
+        __m256d var = _mm256_max_pd(zero, _mm256_sub_pd(_mm256_div_pd(sum2, nt), _mm256_mul_pd(mean, mean)));
+        __m256d verr = _mm256_sqrt_pd(var);
+        mean = _mm256_add_pd(mean, shift);
+        // the lanes that may select this window (PedWindowSelect::Candidate)
+        __m256d bound = _mm256_add_pd(_mm256_loadu_pd(bounds), vtol);
+        int mask = _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(verr, vflat, _CMP_LT_OQ),
+                                                    _mm256_cmp_pd(mean, bound, _CMP_LT_OQ)));
+        if (!mask) { continue; }
+        _mm256_storeu_pd(means, mean);
+        _mm256_storeu_pd(errs, verr);
+        for (int k = 0; mask; ++k, mask >>= 1) {
+            if (mask & 1) {
+                sel[k].Add(x + k, stride, ntrails, i, means[k], errs[k]);
+                bounds[k] = sel[k].bound;
+            }
+        }
+    }
+    for (int k = 0; k < 4; ++k) {
+        Pedestal res;
+        found[k] = sel[k].Result(x + k, stride, ntrails, res);
+        ped[k] = res.mean;
+        err[k] = res.err;
+    }
+}
+
+// trends (see sample_trend) of 4 interleaved waveforms, they are written per lane: trends[k*n + i]
+__attribute__((target("avx2")))
+inline void trend_lanes_avx2(const double *x, size_t n, int8_t *trends)
+{
+    const __m256d pthr = _mm256_set1_pd(0.1), nthr = _mm256_set1_pd(-0.1);
+    for (size_t i = 1; i < n; ++i) {
+        __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(x + i*4), _mm256_loadu_pd(x + (i - 1)*4));
+        int up = _mm256_movemask_pd(_mm256_cmp_pd(diff, pthr, _CMP_GE_OQ));
+        int down = _mm256_movemask_pd(_mm256_cmp_pd(diff, nthr, _CMP_LE_OQ));
+        for (int k = 0; k < 4; ++k) { trends[k*n + i] = ((up >> k) & 1) - ((down >> k) & 1); }
+    }
+}
+
+__attribute__((target("sse2")))
+inline void smooth_lanes_sse2(const double *x, double *out, size_t n, const double *w, size_t res)
+{
+    for (size_t i = 0; i < n; ++i) {
+        __m128d val = _mm_loadu_pd(x + i*2);
+        double weights = 1.;
+        for (size_t j = 1; j < res; ++j) {
+            if (j >= i || j + i >= n) { continue; }
+            __m128d nb = _mm_add_pd(_mm_loadu_pd(x + (i - j)*2), _mm_loadu_pd(x + (i + j)*2));
+            val = _mm_add_pd(val, _mm_mul_pd(_mm_set1_pd(w[j]), nb));
+            weights += 2*w[j];
+        }
+        _mm_storeu_pd(out + i*2, _mm_div_pd(val, _mm_set1_pd(weights)));
+    }
+}
+
+__attribute__((target("sse2")))
+inline void ped_lanes_sse2(const double *x, size_t stride, size_t n, size_t ntrails, double flat, double max_mean,
+                           double *ped, double *err, bool *found)
+{
+    const __m128d shift = _mm_loadu_pd(x), zero = _mm_setzero_pd(), nt = _mm_set1_pd(ntrails);
+    const __m128d vflat = _mm_set1_pd(flat + PED_SUM_TOL), vtol = _mm_set1_pd(PED_SUM_TOL);
+    __m128d sum = zero, sum2 = zero;
+    PedWindowSelect sel[2];
+    double bounds[2], means[2], errs[2];
+    for (int k = 0; k < 2; ++k) {
+        sel[k].Reset(flat, max_mean);
+        bounds[k] = max_mean;
+    }
+    for (size_t i = 0; i < ntrails; ++i) {
+        __m128d val = _mm_sub_pd(_mm_loadu_pd(x + i*stride), shift);
+        sum = _mm_add_pd(sum, val);
+        sum2 = _mm_add_pd(sum2, _mm_mul_pd(val, val));
+    }
+    for (size_t i = 0; i <= n - ntrails; ++i) {
+        if (i > 0) {
+            __m128d v0 = _mm_sub_pd(_mm_loadu_pd(x + (i - 1)*stride), shift);
+            __m128d v1 = _mm_sub_pd(_mm_loadu_pd(x + (i + ntrails - 1)*stride), shift);
+            sum = _mm_add_pd(sum, _mm_sub_pd(v1, v0));
+            sum2 = _mm_add_pd(sum2, _mm_sub_pd(_mm_mul_pd(v1, v1), _mm_mul_pd(v0, v0)));
+        }
+        __m128d mean = _mm_div_pd(sum, nt);
+        __m128d var = _mm_max_pd(zero, _mm_sub_pd(_mm_div_pd(sum2, nt), _mm_mul_pd(mean, mean)));
+        __m128d verr = _mm_sqrt_pd(var);
+        mean = _mm_add_pd(mean, shift);
+        __m128d bound = _mm_add_pd(_mm_loadu_pd(bounds), vtol);
+        int mask = _mm_movemask_pd(_mm_and_pd(_mm_cmplt_pd(verr, vflat), _mm_cmplt_pd(mean, bound)));
+        if (!mask) { continue; }
+        _mm_storeu_pd(means, mean);
+        _mm_storeu_pd(errs, verr);
+        for (int k = 0; mask; ++k, mask >>= 1) {
+            if (mask & 1) {
+                sel[k].Add(x + k, stride, ntrails, i, means[k], errs[k]);
+                bounds[k] = sel[k].bound;
+            }
+        }
+    }
+    for (int k = 0; k < 2; ++k) {
+        Pedestal res;
+        found[k] = sel[k].Result(x + k, stride, ntrails, res);
+        ped[k] = res.mean;
+        err[k] = res.err;
+    }
+}
+
+__attribute__((target("sse2")))
+inline void trend_lanes_sse2(const double *x, size_t n, int8_t *trends)
+{
+    const __m128d pthr = _mm_set1_pd(0.1), nthr = _mm_set1_pd(-0.1);
+    for (size_t i = 1; i < n; ++i) {
+        __m128d diff = _mm_sub_pd(_mm_loadu_pd(x + i*2), _mm_loadu_pd(x + (i - 1)*2));
+        int up = _mm_movemask_pd(_mm_cmpge_pd(diff, pthr));
+        int down = _mm_movemask_pd(_mm_cmple_pd(diff, nthr));
+        for (int k = 0; k < 2; ++k) { trends[k*n + i] = ((up >> k) & 1) - ((down >> k) & 1); }
+    }
+}
+
+// float, twice the lanes
+__attribute__((target("avx2")))
+inline void smooth_lanes_avx2(const float *x, float *out, size_t n, const float *w, size_t res)
+{
+    for (size_t i = 0; i < n; ++i) {
+        __m256 val = _mm256_loadu_ps(x + i*8);
+        float weights = 1.f;
+        for (size_t j = 1; j < res; ++j) {
+            if (j >= i || j + i >= n) { continue; }
+            __m256 nb = _mm256_add_ps(_mm256_loadu_ps(x + (i - j)*8), _mm256_loadu_ps(x + (i + j)*8));
+            val = _mm256_add_ps(val, _mm256_mul_ps(_mm256_set1_ps(w[j]), nb));
+            weights += 2*w[j];
+        }
+        _mm256_storeu_ps(out + i*8, _mm256_div_ps(val, _mm256_set1_ps(weights)));
+    }
+}
+
+__attribute__((target("avx2")))
+inline void trend_lanes_avx2(const float *x, size_t n, int8_t *trends)
+{
+    const __m256 pthr = _mm256_set1_ps(0.1f), nthr = _mm256_set1_ps(-0.1f);
+    for (size_t i = 1; i < n; ++i) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(x + i*8), _mm256_loadu_ps(x + (i - 1)*8));
+        int up = _mm256_movemask_ps(_mm256_cmp_ps(diff, pthr, _CMP_GE_OQ));
+        int down = _mm256_movemask_ps(_mm256_cmp_ps(diff, nthr, _CMP_LE_OQ));
+        for (int k = 0; k < 8; ++k) { trends[k*n + i] = ((up >> k) & 1) - ((down >> k) & 1); }
+    }
+}
+
+__attribute__((target("sse2")))
+inline void smooth_lanes_sse2(const float *x, float *out, size_t n, const float *w, size_t res)
+{
+    for (size_t i = 0; i < n; ++i) {
+        __m128 val = _mm_loadu_ps(x + i*4);
+        float weights = 1.f;
+        for (size_t j = 1; j < res; ++j) {
+            if (j >= i || j + i >= n) { continue; }
+            __m128 nb = _mm_add_ps(_mm_loadu_ps(x + (i - j)*4), _mm_loadu_ps(x + (i + j)*4));
+            val = _mm_add_ps(val, _mm_mul_ps(_mm_set1_ps(w[j]), nb));
+            weights += 2*w[j];
+        }
+        _mm_storeu_ps(out + i*4, _mm_div_ps(val, _mm_set1_ps(weights)));
+    }
+}
+
+__attribute__((target("sse2")))
+inline void trend_lanes_sse2(const float *x, size_t n, int8_t *trends)
+{
+    const __m128 pthr = _mm_set1_ps(0.1f), nthr = _mm_set1_ps(-0.1f);
+    for (size_t i = 1; i < n; ++i) {
+        __m128 diff = _mm_sub_ps(_mm_loadu_ps(x + i*4), _mm_loadu_ps(x + (i - 1)*4));
+        int up = _mm_movemask_ps(_mm_cmpge_ps(diff, pthr));
+        int down = _mm_movemask_ps(_mm_cmple_ps(diff, nthr));
+        for (int k = 0; k < 4; ++k) { trends[k*n + i] = ((up >> k) & 1) - ((down >> k) & 1); }
+    }
+}
+#endif
+
+// the pedestal sums are always in double (see FindPedestal), float lanes are widened first
+inline const double *ped_lanes_data(const std::vector<double> &smoothed, std::vector<double> &/*wide*/)
+{
+    return smoothed.data();
+}
+
+inline const double *ped_lanes_data(const std::vector<float> &smoothed, std::vector<double> &wide)
+{
+    wide.assign(smoothed.begin(), smoothed.end());
+    return wide.data();
+}
+
+// number of waveforms analyzed together, it is the SIMD width of the compute type
+template<typename F>
+size_t AnalyzerT<F>::BatchLanes()
+{
+#ifdef WFANALYZER_SIMD
+    if (__builtin_cpu_supports("avx2")) { return 32/sizeof(F); }
+    if (__builtin_cpu_supports("sse2")) { return 16/sizeof(F); }
+#endif
+    return 1;
+}
+
+template<typename F>
+void AnalyzerT<F>::AnalyzeBatch(const uint32_t *samples, size_t nwfs, size_t nsamples, WfBatchResult &res,
+                                Workspace &ws) const
+{
+    res.Clear();
+    if (!nsamples) { return; }
+
+    // the empty waveforms are skipped with the zero suppression
+    auto &wfs = ws.waveforms;
+    wfs.clear();
+    for (size_t i = 0; i < nwfs; ++i) {
+        const uint32_t *raw = samples + i*nsamples;
+        if (!IsEmpty(raw, nsamples)) { wfs.push_back(raw); }
+    }
+    if (wfs.size() == nwfs) {
+        analyzeWaveforms(wfs.data(), nwfs, nsamples, res, ws);
+        return;
+    }
+
+    // merge the results of the waveforms with signal and the empty ones in the batch order
+    auto &sig = ws.signals;
+    analyzeWaveforms(wfs.data(), wfs.size(), nsamples, sig, ws);
+    res.peds.reserve(nwfs);
+    res.peak_offsets.reserve(nwfs);
+    res.npeaks.reserve(nwfs);
+    for (size_t i = 0, j = 0; i < nwfs; ++i) {
+        const uint32_t *raw = samples + i*nsamples;
+        res.peak_offsets.push_back(res.peaks.size());
+        if ((j < wfs.size()) && (wfs[j] == raw)) {
+            res.peds.push_back(sig.peds[j]);
+            res.peaks.insert(res.peaks.end(), sig.Peaks(j), sig.Peaks(j) + sig.npeaks[j]);
+            res.npeaks.push_back(sig.npeaks[j]);
+            ++j;
+        } else {
+            Pedestal ped;
+            _calc_mean_err(ped.mean, ped.err, raw, nsamples);
+            res.peds.push_back(ped);
+            res.npeaks.push_back(0);
+        }
+    }
+}
+
+// wfs are the pointers to the waveforms
+template<typename F>
+void AnalyzerT<F>::analyzeWaveforms(const uint32_t *const *wfs, size_t nwfs, size_t nsamples, WfBatchResult &res,
+                                    Workspace &ws) const
+{
+    res.Clear();
+    res.peds.reserve(nwfs);
+    res.peak_offsets.reserve(nwfs);
+    res.npeaks.reserve(nwfs);
+
+    // the lane kernels need the precomputed weights and enough samples for the pedestal windows
+    size_t nlanes = ((_res <= SMOOTH_MAX_RES) && (nsamples >= _npeds)) ? BatchLanes() : 1;
+    size_t i = 0;
+    for (; nlanes > 1 && i + nlanes <= nwfs; i += nlanes) {
+        analyzeBatch(wfs + i, nlanes, nsamples, res, ws);
+    }
+
+    // the rest, one at a time
+    for (; i < nwfs; ++i) {
+        const uint32_t *raw = wfs[i];
+        SmoothSpectrum(raw, nsamples, _res, ws.buffer, ws.input);
+        SearchMaxima(ws.buffer, _thres, ws.candidates);
+        res.peds.push_back(FindPedestal(ws.buffer, ws.candidates, ws.ybuf, ws.work));
+        res.peak_offsets.push_back(res.peaks.size());
+        fillPeaks(raw, nsamples, ws.buffer, res.peds.back(), ws.candidates, res.peaks);
+        res.npeaks.push_back(res.peaks.size() - res.peak_offsets.back());
+    }
+}
+
+// nlanes waveforms together, smoothing and the pedestal windows are done on the interleaved samples
+template<typename F>
+void AnalyzerT<F>::analyzeBatch(const uint32_t *const *wfs, size_t nlanes, size_t nsamples, WfBatchResult &res,
+                                Workspace &ws) const
+{
+    auto &x = ws.lanes;
+    x.resize(nsamples*nlanes);
+    for (size_t k = 0; k < nlanes; ++k) {
+        const uint32_t *raw = wfs[k];
+        for (size_t i = 0; i < nsamples; ++i) { x[i*nlanes + k] = raw[i]; }
+    }
+
+    F w[SMOOTH_MAX_RES];
+    for (size_t j = 1; j < _res; ++j) { w[j] = static_cast<F>(1.0 - j/static_cast<double>(_res + 1)); }
+
+    size_t ntrails = std::max(_npeds, nsamples/12);
+    auto &smoothed = ws.smoothed;
+    auto &trends = ws.trends;
+    smoothed.resize(nsamples*nlanes);
+    trends.resize(nsamples*nlanes);
+    double ped_means[8], ped_errs[8];
+    bool ped_found[8];
+#ifdef WFANALYZER_SIMD
+    double max_mean = _overflow*0.95;
+    if (nlanes == 32/sizeof(F)) {
+        smooth_lanes_avx2(x.data(), smoothed.data(), nsamples, w, _res);
+        const double *px = ped_lanes_data(smoothed, ws.ped_lanes);
+        for (size_t k = 0; k < nlanes; k += 4) {
+            ped_lanes_avx2(px + k, nlanes, nsamples, ntrails, _ped_flat, max_mean, ped_means + k, ped_errs + k,
+                           ped_found + k);
+        }
+        trend_lanes_avx2(smoothed.data(), nsamples, trends.data());
+    } else {
+        smooth_lanes_sse2(x.data(), smoothed.data(), nsamples, w, _res);
+        const double *px = ped_lanes_data(smoothed, ws.ped_lanes);
+        for (size_t k = 0; k < nlanes; k += 2) {
+            ped_lanes_sse2(px + k, nlanes, nsamples, ntrails, _ped_flat, max_mean, ped_means + k, ped_errs + k,
+                           ped_found + k);
+        }
+        trend_lanes_sse2(smoothed.data(), nsamples, trends.data());
+    }
+#endif
+
+    auto &buffer = ws.buffer;
+    buffer.resize(nsamples);
+    for (size_t k = 0; k < nlanes; ++k) {
+        for (size_t i = 0; i < nsamples; ++i) { buffer[i] = smoothed[i*nlanes + k]; }
+        searchMaxima(buffer.data(), &trends[k*nsamples], nsamples, _thres, ws.candidates);
+
+        Pedestal ped(ped_means[k], ped_errs[k]);
+        if (!ped_found[k]) {
+            ped = backgroundPedestal(buffer, ws.ybuf, ws.work);
+        }
+
+        res.peds.push_back(ped);
+        res.peak_offsets.push_back(res.peaks.size());
+        fillPeaks(wfs[k], nsamples, buffer, ped, ws.candidates, res.peaks);
+        res.npeaks.push_back(res.peaks.size() - res.peak_offsets.back());
+    }
+}
+
 //find pedestal, it assumes the pedestal is a constant (for simple FADC250 spectrum)
-Pedestal Analyzer::FindPedestal(const std::vector<double> &buffer, const std::vector<Peak> &/*peaks*/) const
+template<typename F>
+Pedestal AnalyzerT<F>::FindPedestal(const std::vector<F> &buffer, const std::vector<Peak> &peaks) const
+{
+    std::vector<F> ybuf, work;
+    return FindPedestal(buffer, peaks, ybuf, work);
+}
+
+// ybuf and work are the scratch buffers for the background estimation
+template<typename F>
+Pedestal AnalyzerT<F>::FindPedestal(const std::vector<F> &buffer, const std::vector<Peak> &/*peaks*/,
+                                    std::vector<F> &ybuf, std::vector<F> &work) const
 {
     Pedestal ped{0., 0.};
     // too few samples, use the minimum value as the pedestal
@@ -123,51 +694,115 @@ Pedestal Analyzer::FindPedestal(const std::vector<double> &buffer, const std::ve
     int ntrails = std::max(_npeds, buffer.size()/12);
     // criteria for good pedestal (some overflow events will have a few flat samples)
     double max_mean = _overflow*0.95;
-    bool find_baseline = false;
 
     // progressively find a good baseline
-    ped.mean = max_mean;
+    // sliding window sums, O(n) for all the windows, values are shifted by the first one to keep the precision
+    // the sums are in double for the float mode too, a pulse passing through the window would leave a rounding error
+    // of its squared height in a float sum2 and flip the flatness cut of the windows after it
+    // the sums only order the windows, the selected one is computed again from scratch (see PedWindowSelect)
+    PedWindowSelect sel(_ped_flat, max_mean);
+    double shift = buffer[0], sum = 0., sum2 = 0.;
+    for (int i = 0; i < ntrails; ++i) {
+        double val = buffer[i] - shift;
+        sum += val;
+        sum2 += val*val;
+    }
     for (size_t i = 0; i <= buffer.size() - ntrails; ++i) {
-        double mean = 0., err = 100.*_ped_flat;
-        _calc_mean_err(mean, err, &buffer[i], ntrails);
-        if(err < _ped_flat && mean < max_mean) {
-            find_baseline = true;
-            if (mean < ped.mean) { ped.mean = mean; ped.err = err; }
+        if (i > 0) {
+            double v0 = buffer[i - 1] - shift, v1 = buffer[i + ntrails - 1] - shift;
+            sum += v1 - v0;
+            sum2 += v1*v1 - v0*v0;
         }
+        double mean = sum/ntrails;
+        double err = std::sqrt(std::max(sum2/ntrails - mean*mean, 0.));
+        mean += shift;
+        sel.Add(&buffer[0], 1, ntrails, i, mean, err);
     }
-    if (find_baseline) {
+    if (sel.Result(&buffer[0], 1, ntrails, ped)) {
         return ped;
     }
 
     // complicated spectrum
-    auto ybuf = buffer;
-    TSpectrum s;
-    s.Background(&ybuf[0], ybuf.size(), ybuf.size()/4, TSpectrum::kBackDecreasingWindow,
-                    TSpectrum::kBackOrder2, false, TSpectrum::kBackSmoothing3, false);
+    return backgroundPedestal(buffer, ybuf, work);
+}
+
+// same window width as FindPedestal, a window of noisy channels is flat if it is consistent with the known rms
+template<typename F>
+bool AnalyzerT<F>::CheckPedestal(const std::vector<F> &buffer, const Pedestal &ped) const
+{
+    if (buffer.size() < _npeds) { return false; }
+
+    size_t ntrails = std::max(_npeds, buffer.size()/12);
+    double flat = std::max(_ped_flat, 3.*ped.err);
+    auto agree = [this, &ped, ntrails, flat] (const F *window) {
+        double mean = 0., err = 0.;
+        _calc_mean_err(mean, err, window, ntrails);
+        return (err < flat) && (std::abs(mean - ped.mean) < _ped_shift);
+    };
+    return agree(&buffer[0]) || agree(&buffer[buffer.size() - ntrails]);
+}
+
+// pedestal from the estimated background, for the spectra without a flat baseline
+template<typename F>
+Pedestal AnalyzerT<F>::backgroundPedestal(const std::vector<F> &buffer, std::vector<F> &ybuf,
+                                          std::vector<F> &work) const
+{
+    ybuf.assign(buffer.begin(), buffer.end());
+    SNIPBackground(&ybuf[0], ybuf.size(), ybuf.size()/4, work);
     return CalcPedestal(&ybuf[ybuf.size()/5], 3*ybuf.size()/5, 1.0, 3, _npeds);
 }
 
-std::vector<Peak> Analyzer::SearchMaxima(const std::vector<double> &buffer, double height_thres) const
+// trend between two samples, 0 if they differ by less than thr
+template<typename F>
+inline int8_t sample_trend(F v1, F v2, F thr = static_cast<F>(0.1))
 {
-    std::vector<Peak> candidates;
-    if (buffer.size() < 3) { return candidates; }
+    return std::abs(v1 - v2) < thr ? 0 : (v1 > v2 ? 1 : -1);
+}
 
+template<typename F>
+std::vector<Peak> AnalyzerT<F>::SearchMaxima(const std::vector<F> &buffer, double height_thres) const
+{
+    std::vector<Peak> candidates;
     candidates.reserve(buffer.size()/3);
+    SearchMaxima(buffer, height_thres, candidates);
+    return candidates;
+}
+
+template<typename F>
+void AnalyzerT<F>::SearchMaxima(const std::vector<F> &buffer, double height_thres, std::vector<Peak> &candidates)
+const
+{
+    candidates.clear();
+    if (buffer.size() < 3) { return; }
+
     // get trend
-    auto trend = [] (double v1, double v2, double thr = 0.1) {
-        return std::abs(v1 - v2) < thr ? 0 : (v1 > v2 ? 1 : -1);
-    };
-    for (uint32_t i = 1; i < buffer.size() - 1; ++i) {
-        int tr1 = trend(buffer[i], buffer[i - 1]);
-        int tr2 = trend(buffer[i], buffer[i + 1]);
+    static thread_local std::vector<int8_t> trends;
+    trends.resize(buffer.size());
+    for (size_t i = 1; i < buffer.size(); ++i) {
+        trends[i] = sample_trend(buffer[i], buffer[i - 1]);
+    }
+    searchMaxima(buffer.data(), trends.data(), buffer.size(), height_thres, candidates);
+}
+
+// trends[i] is the trend from sample i - 1 to i, the one from i + 1 to i is -trends[i + 1]
+template<typename F>
+void AnalyzerT<F>::searchMaxima(const F *buffer, const int8_t *trends, size_t nsamples, double height_thres,
+                                std::vector<Peak> &candidates) const
+{
+    candidates.clear();
+    if (nsamples < 3) { return; }
+
+    for (uint32_t i = 1; i < nsamples - 1; ++i) {
+        int tr1 = trends[i];
+        int tr2 = -trends[i + 1];
         // peak at the rising (declining) edge
         if ((tr1 * tr2 >= 0) && (std::abs(tr1) > 0)) {
             uint32_t left = 1, right = 1;
             // search the peak range
-            while ((i > left + 1) && (trend(buffer[i - left], buffer[i - left - 1]) == tr1)) {
+            while ((i > left + 1) && (trends[i - left] == tr1)) {
                 left ++;
             }
-            while ((i + right < buffer.size() - 1) && (trend(buffer[i + right], buffer[i + right + 1])*tr1 >= 0)) {
+            while ((i + right < nsamples - 1) && (-trends[i + right + 1]*tr1 >= 0)) {
                 right ++;
             }
 
@@ -178,6 +813,305 @@ std::vector<Peak> Analyzer::SearchMaxima(const std::vector<double> &buffer, doub
             }
         }
     }
-    return candidates;
 }
 
+
+
+// smoothing of one sample with the part of the kernel inside the spectrum
+template<typename F>
+inline F smooth_sample(const F *x, size_t n, size_t i, size_t res)
+{
+    F val = x[i];
+    F weights = 1;
+    for (size_t j = 1; j < res; ++j) {
+        if (j >= i || j + i >= n) { continue; }
+        F weight = static_cast<F>(1.0 - j/static_cast<double>(res + 1));
+        val += weight*(x[i - j] + x[i + j]);
+        weights += 2*weight;
+    }
+    return val/weights;
+}
+
+// full kernel for the samples in [beg, end), the operations are in the same order as smooth_sample
+template<typename F>
+inline void smooth_scalar(const F *x, F *out, size_t beg, size_t end, const F *w, size_t res, F wsum)
+{
+    for (size_t i = beg; i < end; ++i) {
+        F val = x[i];
+        for (size_t j = 1; j < res; ++j) {
+            val += w[j]*(x[i - j] + x[i + j]);
+        }
+        out[i] = val/wsum;
+    }
+}
+
+#ifdef WFANALYZER_SIMD
+__attribute__((target("avx2")))
+inline void smooth_avx2(const double *x, double *out, size_t beg, size_t end, const double *w, size_t res,
+                        double wsum)
+{
+    const __m256d vsum = _mm256_set1_pd(wsum);
+    size_t i = beg;
+    for (; i + 4 <= end; i += 4) {
+        __m256d val = _mm256_loadu_pd(x + i);
+        for (size_t j = 1; j < res; ++j) {
+            __m256d nb = _mm256_add_pd(_mm256_loadu_pd(x + i - j), _mm256_loadu_pd(x + i + j));
+            val = _mm256_add_pd(val, _mm256_mul_pd(_mm256_set1_pd(w[j]), nb));
+        }
+        _mm256_storeu_pd(out + i, _mm256_div_pd(val, vsum));
+    }
+    smooth_scalar(x, out, i, end, w, res, wsum);
+}
+
+__attribute__((target("sse2")))
+inline void smooth_sse2(const double *x, double *out, size_t beg, size_t end, const double *w, size_t res,
+                        double wsum)
+{
+    const __m128d vsum = _mm_set1_pd(wsum);
+    size_t i = beg;
+    for (; i + 2 <= end; i += 2) {
+        __m128d val = _mm_loadu_pd(x + i);
+        for (size_t j = 1; j < res; ++j) {
+            __m128d nb = _mm_add_pd(_mm_loadu_pd(x + i - j), _mm_loadu_pd(x + i + j));
+            val = _mm_add_pd(val, _mm_mul_pd(_mm_set1_pd(w[j]), nb));
+        }
+        _mm_storeu_pd(out + i, _mm_div_pd(val, vsum));
+    }
+    smooth_scalar(x, out, i, end, w, res, wsum);
+}
+
+__attribute__((target("avx2")))
+inline void smooth_avx2(const float *x, float *out, size_t beg, size_t end, const float *w, size_t res, float wsum)
+{
+    const __m256 vsum = _mm256_set1_ps(wsum);
+    size_t i = beg;
+    for (; i + 8 <= end; i += 8) {
+        __m256 val = _mm256_loadu_ps(x + i);
+        for (size_t j = 1; j < res; ++j) {
+            __m256 nb = _mm256_add_ps(_mm256_loadu_ps(x + i - j), _mm256_loadu_ps(x + i + j));
+            val = _mm256_add_ps(val, _mm256_mul_ps(_mm256_set1_ps(w[j]), nb));
+        }
+        _mm256_storeu_ps(out + i, _mm256_div_ps(val, vsum));
+    }
+    smooth_scalar(x, out, i, end, w, res, wsum);
+}
+
+__attribute__((target("sse2")))
+inline void smooth_sse2(const float *x, float *out, size_t beg, size_t end, const float *w, size_t res, float wsum)
+{
+    const __m128 vsum = _mm_set1_ps(wsum);
+    size_t i = beg;
+    for (; i + 4 <= end; i += 4) {
+        __m128 val = _mm_loadu_ps(x + i);
+        for (size_t j = 1; j < res; ++j) {
+            __m128 nb = _mm_add_ps(_mm_loadu_ps(x + i - j), _mm_loadu_ps(x + i + j));
+            val = _mm_add_ps(val, _mm_mul_ps(_mm_set1_ps(w[j]), nb));
+        }
+        _mm_storeu_ps(out + i, _mm_div_ps(val, vsum));
+    }
+    smooth_scalar(x, out, i, end, w, res, wsum);
+}
+#endif
+
+template<typename F>
+void AnalyzerT<F>::SmoothKernel(const F *x, size_t n, size_t res, std::vector<F> &buffer)
+{
+    if (res <= 1) {
+        buffer.assign(x, x + n);
+        return;
+    }
+
+    buffer.resize(n);
+    F *out = buffer.data();
+    // samples with the full kernel
+    size_t beg = res, end = (n + 1 > res) ? n + 1 - res : 0;
+    if ((res > SMOOTH_MAX_RES) || (beg >= end)) {
+        for (size_t i = 0; i < n; ++i) { out[i] = smooth_sample(x, n, i, res); }
+        return;
+    }
+
+    // weights and normalization, summed in the same order as smooth_sample
+    F w[SMOOTH_MAX_RES], wsum = 1;
+    for (size_t j = 1; j < res; ++j) {
+        w[j] = static_cast<F>(1.0 - j/static_cast<double>(res + 1));
+        wsum += 2*w[j];
+    }
+
+    for (size_t i = 0; i < beg; ++i) { out[i] = smooth_sample(x, n, i, res); }
+#ifdef WFANALYZER_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        smooth_avx2(x, out, beg, end, w, res, wsum);
+    } else if (__builtin_cpu_supports("sse2")) {
+        smooth_sse2(x, out, beg, end, w, res, wsum);
+    } else {
+        smooth_scalar(x, out, beg, end, w, res, wsum);
+    }
+#else
+    smooth_scalar(x, out, beg, end, w, res, wsum);
+#endif
+    for (size_t i = end; i < n; ++i) { out[i] = smooth_sample(x, n, i, res); }
+}
+
+
+// min and max of the samples in [beg, end)
+inline void range_scalar(const uint32_t *x, size_t beg, size_t end, uint32_t &lo, uint32_t &hi)
+{
+    for (size_t i = beg; i < end; ++i) {
+        lo = std::min(lo, x[i]);
+        hi = std::max(hi, x[i]);
+    }
+}
+
+#ifdef WFANALYZER_SIMD
+// the SIMD part, it returns the number of samples done and leaves the rest to range_scalar
+__attribute__((target("avx2")))
+inline size_t range_avx2(const uint32_t *x, size_t n, uint32_t &lo, uint32_t &hi)
+{
+    if (n < 8) { return 0; }
+    __m256i vlo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x)), vhi = vlo;
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+        vlo = _mm256_min_epu32(vlo, v);
+        vhi = _mm256_max_epu32(vhi, v);
+    }
+    uint32_t los[8], his[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(los), vlo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(his), vhi);
+    range_scalar(los, 0, 8, lo, hi);
+    range_scalar(his, 0, 8, lo, hi);
+    return i;
+}
+
+// unsigned 32-bit min/max need sse4.1
+__attribute__((target("sse4.1")))
+inline size_t range_sse41(const uint32_t *x, size_t n, uint32_t &lo, uint32_t &hi)
+{
+    if (n < 4) { return 0; }
+    __m128i vlo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x)), vhi = vlo;
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+        vlo = _mm_min_epu32(vlo, v);
+        vhi = _mm_max_epu32(vhi, v);
+    }
+    uint32_t los[4], his[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(los), vlo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(his), vhi);
+    range_scalar(los, 0, 4, lo, hi);
+    range_scalar(his, 0, 4, lo, hi);
+    return i;
+}
+#endif
+
+template<typename F>
+uint32_t AnalyzerT<F>::SampleRange(const uint32_t *samples, size_t nsamples)
+{
+    if (!nsamples) { return 0; }
+
+    uint32_t lo = samples[0], hi = samples[0];
+    size_t i = 0;
+#ifdef WFANALYZER_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        i = range_avx2(samples, nsamples, lo, hi);
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        i = range_sse41(samples, nsamples, lo, hi);
+    }
+#endif
+    range_scalar(samples, i, nsamples, lo, hi);
+    return hi - lo;
+}
+
+
+// one clipping pass of window i for the samples in [beg, end): out = min(y, (y[-i] + y[+i])/2)
+template<typename F>
+inline void snip_scalar(const F *y, F *out, size_t beg, size_t end, size_t i)
+{
+    for (size_t j = beg; j < end; ++j) {
+        F a = y[j];
+        F b = (y[j - i] + y[j + i])/2;
+        out[j] = (b < a) ? b : a;
+    }
+}
+
+#ifdef WFANALYZER_SIMD
+__attribute__((target("avx2")))
+inline void snip_avx2(const double *y, double *out, size_t beg, size_t end, size_t i)
+{
+    const __m256d half = _mm256_set1_pd(0.5);
+    size_t j = beg;
+    for (; j + 4 <= end; j += 4) {
+        __m256d b = _mm256_mul_pd(_mm256_add_pd(_mm256_loadu_pd(y + j - i), _mm256_loadu_pd(y + j + i)), half);
+        // min_pd(b, a) is (b < a) ? b : a
+        _mm256_storeu_pd(out + j, _mm256_min_pd(b, _mm256_loadu_pd(y + j)));
+    }
+    snip_scalar(y, out, j, end, i);
+}
+
+__attribute__((target("sse2")))
+inline void snip_sse2(const double *y, double *out, size_t beg, size_t end, size_t i)
+{
+    const __m128d half = _mm_set1_pd(0.5);
+    size_t j = beg;
+    for (; j + 2 <= end; j += 2) {
+        __m128d b = _mm_mul_pd(_mm_add_pd(_mm_loadu_pd(y + j - i), _mm_loadu_pd(y + j + i)), half);
+        _mm_storeu_pd(out + j, _mm_min_pd(b, _mm_loadu_pd(y + j)));
+    }
+    snip_scalar(y, out, j, end, i);
+}
+
+__attribute__((target("avx2")))
+inline void snip_avx2(const float *y, float *out, size_t beg, size_t end, size_t i)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    size_t j = beg;
+    for (; j + 8 <= end; j += 8) {
+        __m256 b = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(y + j - i), _mm256_loadu_ps(y + j + i)), half);
+        _mm256_storeu_ps(out + j, _mm256_min_ps(b, _mm256_loadu_ps(y + j)));
+    }
+    snip_scalar(y, out, j, end, i);
+}
+
+__attribute__((target("sse2")))
+inline void snip_sse2(const float *y, float *out, size_t beg, size_t end, size_t i)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t j = beg;
+    for (; j + 4 <= end; j += 4) {
+        __m128 b = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(y + j - i), _mm_loadu_ps(y + j + i)), half);
+        _mm_storeu_ps(out + j, _mm_min_ps(b, _mm_loadu_ps(y + j)));
+    }
+    snip_scalar(y, out, j, end, i);
+}
+#endif
+
+// SNIP background with the 2nd order clipping filter and decreasing clipping windows (niters down to 1), without
+// smoothing, the same as TSpectrum::Background(y, n, niters, kBackDecreasingWindow, kBackOrder2, false, *, false)
+// the spectrum is replaced by the background, it is left as it is for invalid parameters (as TSpectrum does)
+template<typename F>
+void AnalyzerT<F>::SNIPBackground(F *y, size_t n, size_t niters, std::vector<F> &work)
+{
+    if (!n || !niters || (n < 2*niters + 1)) {
+        return;
+    }
+
+    work.resize(n);
+    F *out = work.data();
+    void (*clip)(const F *, F *, size_t, size_t, size_t) = snip_scalar<F>;
+#ifdef WFANALYZER_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        clip = snip_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        clip = snip_sse2;
+    }
+#endif
+    for (size_t i = niters; i >= 1; --i) {
+        clip(y, out, i, n - i, i);
+        std::copy(out + i, out + n - i, y + i);
+    }
+}
+
+
+// double precision (default) and single precision
+template class fdec::AnalyzerT<double>;
+template class fdec::AnalyzerT<float>;
@@ -15,6 +15,8 @@
 
 namespace fdec {
 
+class PulseTemplate;
+
 // some help functions
 // calculate mean and standard deviation of an array
 template<typename T>
@@ -72,28 +74,119 @@ inline void _linear_regr(double &p0, double &p1, double &err, const T *x, const
     err = std::sqrt(err/static_cast<double>(npts));
 }
 
-// analyzer class
-class Analyzer
+// results of a batch of waveforms, the peaks of waveform i are peaks[peak_offsets[i], peak_offsets[i] + npeaks[i])
+struct WfBatchResult
+{
+    std::vector<Pedestal> peds;
+    std::vector<uint32_t> peak_offsets, npeaks;
+    std::vector<Peak> peaks;
+
+    void Clear() { peds.clear(), peak_offsets.clear(), npeaks.clear(), peaks.clear(); }
+    size_t Size() const { return peds.size(); }
+    const Peak *Peaks(size_t i) const { return peaks.data() + peak_offsets[i]; }
+
+    // append the results of another batch (the parts of a parallel analysis)
+    void Append(const WfBatchResult &other)
+    {
+        uint32_t offset = peaks.size();
+        peds.insert(peds.end(), other.peds.begin(), other.peds.end());
+        for (auto off : other.peak_offsets) { peak_offsets.push_back(off + offset); }
+        npeaks.insert(npeaks.end(), other.npeaks.begin(), other.npeaks.end());
+        peaks.insert(peaks.end(), other.peaks.begin(), other.peaks.end());
+    }
+
+    // adapter to the per-channel structure, raw samples are not touched
+    void ToData(size_t i, Fadc250Data &data) const
+    {
+        data.ped = peds[i];
+        data.peaks.assign(Peaks(i), Peaks(i) + npeaks[i]);
+    }
+};
+
+// scratch buffers for the analysis, use one per thread, they only grow so the analysis does not allocate once they
+// reach the waveform size
+template<typename F>
+struct AnalyzerWorkspaceT
+{
+    std::vector<F> input, buffer, ybuf, work;
+    std::vector<Peak> candidates;
+    // batch analysis, waveforms interleaved by lanes (sample i of lane k at i*nlanes + k)
+    std::vector<F> lanes, smoothed;
+    std::vector<int8_t> trends;
+    // the smoothed lanes in double for the pedestal sums, only used by the float mode
+    std::vector<double> ped_lanes;
+    // batch zero suppression, the waveforms with signal and their results
+    std::vector<const uint32_t*> waveforms;
+    WfBatchResult signals;
+
+    AnalyzerWorkspaceT(size_t nsamples = FADC250_MAX_NSAMPLES)
+    {
+        input.reserve(nsamples);
+        buffer.reserve(nsamples);
+        ybuf.reserve(nsamples);
+        work.reserve(nsamples);
+        candidates.reserve(nsamples/3 + 1);
+    }
+};
+
+// analyzer class, F is the compute type of the spectrum (smoothing, peak search and background), float doubles the
+// SIMD width, the pedestal window sums and the results (Peak and Pedestal) are always in double
+template<typename F>
+class AnalyzerT
 {
 public:
+    using Workspace = AnalyzerWorkspaceT<F>;
+
     // clk is in MHz
-    Analyzer(size_t resolution = 2, double threshold = 10.0,
-             size_t n_ped_samples = 5, double ped_flatness = 1.0,
-             uint32_t max_value = 4096, double clk = 250.);
-    virtual ~Analyzer() {}
+    AnalyzerT(size_t resolution = 2, double threshold = 10.0,
+              size_t n_ped_samples = 5, double ped_flatness = 1.0,
+              uint32_t max_value = 4096, double clk = 250.);
+    virtual ~AnalyzerT() {}
 
     // analyze waveform samples
     void Analyze(Fadc250Data &data) const;
+    void Analyze(Fadc250Data &data, Workspace &ws) const;
     Fadc250Data Analyze(const uint32_t *samples, size_t nsamples) const;
 
+    // analyze with a known pedestal (e.g. from PedestalDB), the pedestal search is skipped if the baseline agrees with
+    // it (see CheckPedestal), returns false if the known pedestal is not used
+    bool Analyze(Fadc250Data &data, const Pedestal &ped, Workspace &ws) const;
+
+    // analyze a batch of equal-length waveforms, waveform i is samples[i*nsamples, (i + 1)*nsamples)
+    // the smoothing and the pedestal windows run on several waveforms at once (SIMD lanes), results are the same as
+    // Analyze on each waveform
+    void AnalyzeBatch(const uint32_t *samples, size_t nwaveforms, size_t nsamples, WfBatchResult &res,
+                      Workspace &ws) const;
+
     // find pedestal, it assumes the pedestal is a constant (for simple FADC250 spectrum)
-    Pedestal FindPedestal(const std::vector<double> &buffer, const std::vector<Peak> &/*peaks*/) const;
+    Pedestal FindPedestal(const std::vector<F> &buffer, const std::vector<Peak> &/*peaks*/) const;
+    Pedestal FindPedestal(const std::vector<F> &buffer, const std::vector<Peak> &/*peaks*/,
+                          std::vector<F> &ybuf, std::vector<F> &work) const;
+    // the baseline agrees with a known pedestal if the window at either end of the spectrum is flat (within the
+    // flatness or 3 rms of the pedestal) and its mean shifts less than the tolerance (SetPedShift, 2 adc counts by
+    // default), the pulses are expected in between
+    bool CheckPedestal(const std::vector<F> &buffer, const Pedestal &ped) const;
+
+    // sub-sample time and amplitude of the peaks from a template fit (see PulseTemplate), run it after the analysis,
+    // the overflow peaks and the failed fits keep the sample values, it returns the number of fitted peaks
+    size_t FitPeaks(Fadc250Data &data, const PulseTemplate &tmpl) const;
+
+    // zero suppression: the waveforms whose samples span less than the peak threshold cannot have a peak, they are
+    // not analyzed and the pedestal is the mean and rms of the samples (or the known pedestal if it agrees)
+    bool IsEmpty(const uint32_t *samples, size_t nsamples) const
+    {
+        return _zero_sup && (SampleRange(samples, nsamples) < _thres);
+    }
 
     // search local maxima as peak candidates
-    std::vector<Peak> SearchMaxima(const std::vector<double> &buffer, double height_thres) const;
+    std::vector<Peak> SearchMaxima(const std::vector<F> &buffer, double height_thres) const;
+    void SearchMaxima(const std::vector<F> &buffer, double height_thres, std::vector<Peak> &candidates) const;
 
     // get
     double GetThreshold() const { return _thres; }
+    double GetPedFlatness() const { return _ped_flat; }
+    double GetPedShift() const { return _ped_shift; }
+    bool GetZeroSuppression() const { return _zero_sup; }
     double GetClockFreq() const { return _clk; }
     size_t GetResolution() const { return _res; }
     size_t GetNSamplesPed() const { return _npeds; }
@@ -101,40 +194,71 @@ public:
 
     // set
     void SetThreshold(double thres) { _thres = thres; }
+    void SetPedFlatness(double flat) { _ped_flat = flat; }
+    void SetPedShift(double shift) { _ped_shift = shift; }
+    void SetZeroSuppression(bool zero_sup) { _zero_sup = zero_sup; }
     void SetClockFreq(double clk) { _clk = clk; }
     void SetResolution(size_t res) { _res = res; }
     void SetNSamplesPed(size_t npeds) { _npeds = npeds; }
     void SetOverflowValue(uint32_t overflow) { _overflow = overflow; }
 
 private:
-    double _thres, _clk, _ped_flat;
+    void analyzeWaveforms(const uint32_t *const *wfs, size_t nwfs, size_t nsamples, WfBatchResult &res,
+                          Workspace &ws) const;
+    void analyzeBatch(const uint32_t *const *wfs, size_t nlanes, size_t nsamples, WfBatchResult &res,
+                      Workspace &ws) const;
+    void searchMaxima(const F *buffer, const int8_t *trends, size_t nsamples, double height_thres,
+                      std::vector<Peak> &candidates) const;
+    Pedestal backgroundPedestal(const std::vector<F> &buffer, std::vector<F> &ybuf, std::vector<F> &work) const;
+    void fillPeaks(const uint32_t *samples, size_t nsamples, const std::vector<F> &buffer, const Pedestal &ped,
+                   std::vector<Peak> &candidates, std::vector<Peak> &peaks) const;
+
+    double _thres, _clk, _ped_flat, _ped_shift;
     size_t _res, _npeds;
     uint32_t _overflow;
+    bool _zero_sup;
 
 
 public:
     // static methods
     template<typename T>
-    static std::vector<double> SmoothSpectrum(const T *samples, size_t nsamples, size_t res)
+    static std::vector<F> SmoothSpectrum(const T *samples, size_t nsamples, size_t res)
     {
-        if (res <= 1) {
-            return std::vector<double>(samples, samples + nsamples);
-        }
-        std::vector<double> buffer(nsamples);
-        for (size_t i = 0; i < nsamples; ++i) {
-            double val = samples[i];
-            double weights = 1.0;
-            for (size_t j = 1; j < res; ++j) {
-                if (j >= i || j + i >= nsamples) { continue; }
-                double weight = 1.0 - j/static_cast<double>(res + 1);
-                val += weight*(samples[i - j] + samples[i + j]);
-                weights += 2.*weight;
-            }
-            buffer[i] = val/weights;
-        }
+        std::vector<F> buffer;
+        SmoothSpectrum(samples, nsamples, res, buffer);
         return buffer;
     }
 
+    template<typename T>
+    static void SmoothSpectrum(const T *samples, size_t nsamples, size_t res, std::vector<F> &buffer)
+    {
+        static thread_local std::vector<F> input;
+        SmoothSpectrum(samples, nsamples, res, buffer, input);
+    }
+
+    // input is the scratch buffer for the samples converted to the compute type
+    template<typename T>
+    static void SmoothSpectrum(const T *samples, size_t nsamples, size_t res, std::vector<F> &buffer,
+                               std::vector<F> &input)
+    {
+        input.assign(samples, samples + nsamples);
+        SmoothKernel(input.data(), nsamples, res, buffer);
+    }
+
+    // max - min of the samples
+    static uint32_t SampleRange(const uint32_t *samples, size_t nsamples);
+
+    // number of waveforms AnalyzeBatch runs together (SIMD lanes of the compute type on this cpu), 1 without SIMD
+    static size_t BatchLanes();
+
+    // background estimation with the SNIP algorithm (2nd order filter, decreasing windows), y is replaced by the
+    // background, work is the scratch buffer
+    static void SNIPBackground(F *y, size_t n, size_t niters, std::vector<F> &work);
+
+    // triangular smoothing, weights are 1 - j/(res + 1) for the neighbors j < res away, samples close to the edges
+    // only use the neighbors inside the spectrum (the first sample is never a neighbor)
+    static void SmoothKernel(const F *samples, size_t nsamples, size_t res, std::vector<F> &buffer);
+
     template<typename T>
     static Pedestal CalcPedestal(T *ybuf, size_t npts, double thres = 1.0, int max_iters = 3, int min_npeds = 5)
     {
@@ -157,7 +281,15 @@ public:
         return res;
     }
 
-};  // class Analyzer
+};  // class AnalyzerT
 
-};  // namespace fdec
+// double is the default, float is the single-precision mode
+using Analyzer = AnalyzerT<double>;
+using AnalyzerF = AnalyzerT<float>;
+using AnalyzerWorkspace = AnalyzerWorkspaceT<double>;
+using AnalyzerWorkspaceF = AnalyzerWorkspaceT<float>;
 
+extern template class AnalyzerT<double>;
+extern template class AnalyzerT<float>;
+
+};  // namespace fdec
@@ -0,0 +1,84 @@
+//
+// Batch analysis of the FADC250 waveforms
+//
+
+#include "WfBatch.h"
+
+
+using namespace fdec;
+
+bool WfBatch::Add(const uint32_t *buf, size_t len, uint32_t event, uint32_t channel)
+{
+    if (!len) { return false; }
+    if (events.empty()) {
+        nsamples = len;
+    } else if (len != nsamples) {
+        return false;
+    }
+
+    samples.insert(samples.end(), buf, buf + len);
+    events.push_back(event);
+    channels.push_back(channel);
+    return true;
+}
+
+size_t WfBatch::Add(const std::vector<Fadc250FlatEvent> &evs, size_t nevents)
+{
+    size_t count = 0;
+    for (size_t i = 0; (i < nevents) && (i < evs.size()); ++i) {
+        auto &ev = evs[i];
+        for (uint32_t ch = 0; ch < FADC250_MAX_NCHANS; ++ch) {
+            count += Add(ev.Samples(ch), ev.lengths[ch], i, ch);
+        }
+    }
+    return count;
+}
+
+size_t WfBatch::Add(const std::vector<Fadc250Event> &evs, size_t nevents)
+{
+    size_t count = 0;
+    for (size_t i = 0; (i < nevents) && (i < evs.size()); ++i) {
+        auto &ev = evs[i];
+        for (uint32_t ch = 0; ch < ev.channels.size(); ++ch) {
+            count += Add(ev.channels[ch].raw.data(), ev.channels[ch].raw.size(), i, ch);
+        }
+    }
+    return count;
+}
+
+
+template<typename F>
+WfBatchAnalyzerT<F>::WfBatchAnalyzerT(const AnalyzerT<F> &ana, size_t nthreads, size_t min_part)
+: _ana(ana), _pool(nthreads), _min_part(std::max(min_part, AnalyzerT<F>::BatchLanes()))
+{
+    _ws.resize(_pool.Size());
+}
+
+template<typename F>
+void WfBatchAnalyzerT<F>::Analyze(const uint32_t *samples, size_t nwfs, size_t nsamples, WfBatchResult &res)
+{
+    // a few parts per thread for the load balance, they are multiples of the batch lanes to fill the SIMD lanes
+    size_t lanes = AnalyzerT<F>::BatchLanes();
+    size_t part = std::max(_min_part, nwfs/(4*_pool.Size()));
+    part = (part + lanes - 1)/lanes*lanes;
+    size_t nparts = (nwfs + part - 1)/part;
+    if (nparts <= 1) {
+        _ana.AnalyzeBatch(samples, nwfs, nsamples, res, _ws[0]);
+        return;
+    }
+
+    if (_parts.size() < nparts) { _parts.resize(nparts); }
+    _pool.Run(nparts, [&] (size_t i, size_t thread) {
+        size_t beg = i*part, n = std::min(part, nwfs - beg);
+        _ana.AnalyzeBatch(samples + beg*nsamples, n, nsamples, _parts[i], _ws[thread]);
+    });
+
+    res.Clear();
+    for (size_t i = 0; i < nparts; ++i) {
+        res.Append(_parts[i]);
+    }
+}
+
+
+template class fdec::WfBatchAnalyzerT<double>;
+template class fdec::WfBatchAnalyzerT<float>;
@@ -0,0 +1,66 @@
+#pragma once
+
+//
+// Batch analysis of the FADC250 waveforms
+// Waveforms of the same length (all the window raw channels of a block of events) are packed contiguously and
+// analyzed together, the batch is split into parts for the worker threads
+//
+
+#include "Fadc250Decoder.h"
+#include "WfAnalyzer.h"
+#include "ThreadPool.h"
+
+
+namespace fdec
+{
+
+// packed waveforms of the same length, waveform i is samples[i*nsamples, (i + 1)*nsamples) from the channel
+// channels[i] of the event events[i]
+struct WfBatch
+{
+    size_t nsamples = 0;
+    std::vector<uint32_t> samples, events, channels;
+
+    void Clear() { nsamples = 0, samples.clear(), events.clear(), channels.clear(); }
+    size_t Size() const { return events.size(); }
+    const uint32_t *Samples(size_t i) const { return samples.data() + i*nsamples; }
+
+    // the first waveform sets the length, the ones with a different length are rejected
+    bool Add(const uint32_t *buf, size_t len, uint32_t event, uint32_t channel);
+    // window raw channels of the events, returns the number of added waveforms
+    size_t Add(const std::vector<Fadc250FlatEvent> &events, size_t nevents);
+    size_t Add(const std::vector<Fadc250Event> &events, size_t nevents);
+};
+
+template<typename F>
+class WfBatchAnalyzerT
+{
+public:
+    // nthreads includes the calling thread, 0 uses the hardware concurrency
+    WfBatchAnalyzerT(const AnalyzerT<F> &ana = AnalyzerT<F>(), size_t nthreads = 1, size_t min_part = 64);
+
+    void Analyze(const uint32_t *samples, size_t nwaveforms, size_t nsamples, WfBatchResult &res);
+    void Analyze(const WfBatch &batch, WfBatchResult &res)
+    {
+        Analyze(batch.samples.data(), batch.Size(), batch.nsamples, res);
+    }
+
+    AnalyzerT<F> &GetAnalyzer() { return _ana; }
+    const AnalyzerT<F> &GetAnalyzer() const { return _ana; }
+    size_t GetNThreads() const { return _pool.Size(); }
+
+private:
+    AnalyzerT<F> _ana;
+    ThreadPool _pool;
+    size_t _min_part;
+    std::vector<AnalyzerWorkspaceT<F>> _ws;
+    std::vector<WfBatchResult> _parts;
+};
+
+using WfBatchAnalyzer = WfBatchAnalyzerT<double>;
+using WfBatchAnalyzerF = WfBatchAnalyzerT<float>;
+
+extern template class WfBatchAnalyzerT<double>;
+extern template class WfBatchAnalyzerT<float>;
+
+}; // namespace fdec
@@ -6,7 +6,6 @@
 #include "TGraphErrors.h"
 #include "TMultiGraph.h"
 #include "TLegend.h"
-#include "TSpectrum.h"
 #include "TStyle.h"
 #include "TAxis.h"
 #include <algorithm>
@@ -160,13 +159,10 @@ WfRootGraph get_waveform_graph(const Analyzer &ana, const std::vector<uint32_t>
     res.objs.push_back(dynamic_cast<TObject*>(grp));
     res.entries.emplace_back(LegendEntry{grp, "Pedestal", "lf"});
 
-    // TSpectrum background
+    // SNIP background (the same as the TSpectrum one)
     if (cfg.show_tspec) {
-        std::vector<double> tped(samples.size());
-        tped.assign(samples.begin(), samples.end());
-        TSpectrum s;
-        s.Background(&tped[0], samples.size(), samples.size()/4, TSpectrum::kBackDecreasingWindow,
-                     TSpectrum::kBackOrder2, false, TSpectrum::kBackSmoothing3, false);
+        std::vector<double> tped(samples.begin(), samples.end()), work;
+        Analyzer::SNIPBackground(&tped[0], tped.size(), tped.size()/4, work);
         auto grp2 = new TGraph(samples.size());
         for (size_t i = 0; i < samples.size(); ++i) {
             grp2->SetPoint(i, i, tped[i]);
@@ -176,7 +172,7 @@ WfRootGraph get_waveform_graph(const Analyzer &ana, const std::vector<uint32_t>
         grp2->SetLineColor(kBlack);
         res.mg->Add(grp2, "l");
         res.objs.push_back(dynamic_cast<TObject*>(grp2));
-        res.entries.emplace_back(LegendEntry{grp2, "TSpectrum Background", "l"});
+        res.entries.emplace_back(LegendEntry{grp2, "SNIP Background", "l"});
     }
 
     return res;
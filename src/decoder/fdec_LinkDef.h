@@ -11,6 +11,7 @@
 
 #pragma link C++ class fdec::Peak+;
 #pragma link C++ class fdec::Pedestal+;
+#pragma link C++ class fdec::PulseWindow+;
 #pragma link C++ class fdec::Fadc250Data+;
 
 #endif
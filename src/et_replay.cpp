@@ -0,0 +1,382 @@
+//=============================================================================
+// et_replay                                                                 ||
+// Start a local ET system, replay an evio file into it and consume it with  ||
+// EtChannel, so the online chain can be benchmarked without a live DAQ      ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include "EvChannel.h"
+#include "EtChannel.h"
+#include "EvSwap.h"
+#include "ConfigArgs.h"
+
+#define CODA_BLOCK_MAGIC 0xc0da0100
+#define CODA_BLOCK_HEADER_SIZE 8
+
+// steady_clock is CLOCK_MONOTONIC on Linux, so it is comparable between the producer and consumer processes
+using clk = std::chrono::steady_clock;
+
+
+struct ReplayOptions
+{
+    std::string et_file, station, stats_file;
+    int port, nevents, nloops, block, cue, chunk, prescale;
+    size_t event_size;
+    double rate;
+    bool swap, scan;
+};
+
+// summary sent from the producer process to the consumer process
+struct ProducerReport
+{
+    uint64_t nevents, nblocks;
+    double time;
+};
+
+static std::vector<std::vector<uint32_t>> load_events(const std::string &path, int nev);
+static pid_t fork_producer(const std::vector<std::vector<uint32_t>> &events, const ReplayOptions &opt,
+                           int go_fd, int report_fd);
+static void consume(const ReplayOptions &opt, int go_fd, int report_fd);
+
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddPositional("raw_data",
+            "raw data in evio format to be replayed");
+    arg_parser.AddArgs<std::string>({"-f", "--et-file"}, "et_file",
+            "memory mapped file of the local ET system",
+            "/tmp/et_replay");
+    arg_parser.AddArgs<int>({"-p", "--port"}, "port",
+            "server port of the local ET system",
+            ET_SERVER_PORT + 7);
+    arg_parser.AddArg<int>("-n", "nev",
+            "number of events to load from the file (< 0 means all)", -1);
+    arg_parser.AddArgs<int>({"-l", "--loops"}, "loops",
+            "number of times to replay the loaded events", 10);
+    arg_parser.AddArgs<double>({"-r", "--rate"}, "rate",
+            "replay rate in events/s (<= 0 means as fast as possible)", 0.);
+    arg_parser.AddArgs<int>({"-b", "--block"}, "block",
+            "number of events per CODA block (<= 1 means single-event form)", 1);
+    arg_parser.AddArgs<int>({"-c", "--cue"}, "cue",
+            "input queue length of the consumer station", ET_STATION_CUE);
+    arg_parser.AddArg<int>("--chunk", "chunk",
+            "events per fetch, 0 means the cue, < 0 means auto-tuned up to the cue", 0);
+    arg_parser.AddArg<int>("--prescale", "prescale",
+            "maximum adaptive prescale of physics events (<= 1 means disabled)", 1);
+    arg_parser.AddArg<std::string>("--stats-file", "stats_file",
+            "file to dump the event-age statistics of the consumer every second", "");
+    arg_parser.AddArg<int>("--et-events", "et_events",
+            "number of events in the ET system", 300);
+    arg_parser.AddArg<int>("--et-size", "et_size",
+            "size of an ET event in bytes", 256*1024);
+    arg_parser.AddArg<std::string>("--station", "station",
+            "name of the consumer station", "et_replay");
+    arg_parser.AddSwitches({"-s", "--swap"}, "swap",
+            "write the data in the opposite endian, like VME crates do");
+    arg_parser.AddSwitch("--scan", "scan",
+            "scan the banks of every consumed event");
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    ReplayOptions opt;
+    opt.et_file = args["et_file"].String();
+    opt.station = args["station"].String();
+    opt.stats_file = args["stats_file"].String();
+    opt.port = args["port"].Int();
+    opt.nevents = args["et_events"].Int();
+    opt.event_size = args["et_size"].ULong();
+    opt.nloops = std::max(args["loops"].Int(), 1);
+    opt.block = std::max(args["block"].Int(), 1);
+    opt.cue = args["cue"].Int();
+    opt.chunk = args["chunk"].Int();
+    opt.prescale = args["prescale"].Int();
+    opt.rate = args["rate"].Double();
+    opt.swap = args["swap"].Bool();
+    opt.scan = args["scan"].Bool();
+
+    auto events = load_events(args["raw_data"].String(), args["nev"].Int());
+    if (events.empty()) {
+        std::cout << "No events loaded from \"" << args["raw_data"].String() << "\"" << std::endl;
+        return -1;
+    }
+    std::cout << "Loaded " << events.size() << " events from \"" << args["raw_data"].String() << "\"" << std::endl;
+
+    // an ET system can only be opened once per process, so the ET system and the producer live in a child process
+    int go_pipe[2], report_pipe[2];
+    if ((pipe(go_pipe) != 0) || (pipe(report_pipe) != 0)) {
+        std::cout << "Cannot create pipes to the producer process" << std::endl;
+        return -1;
+    }
+    pid_t pid = fork_producer(events, opt, go_pipe[0], report_pipe[1]);
+    if (pid < 0) {
+        std::cout << "Cannot fork the producer process" << std::endl;
+        return -1;
+    }
+    close(go_pipe[0]);
+    close(report_pipe[1]);
+
+    consume(opt, go_pipe[1], report_pipe[0]);
+
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    unlink(opt.et_file.c_str());
+    return 0;
+}
+
+// read all the events into memory, so the file system does not interfere with the replay
+static std::vector<std::vector<uint32_t>> load_events(const std::string &path, int nev)
+{
+    std::vector<std::vector<uint32_t>> res;
+    evc::EvChannel evchan;
+    if (evchan.Open(path) != evc::status::success) {
+        return res;
+    }
+
+    while ((nev-- != 0) && (evchan.Read() == evc::status::success)) {
+        auto buf = evchan.GetRawBuffer();
+        res.emplace_back(buf, buf + evchan.GetEvHeader().length + 1);
+    }
+    evchan.Close();
+    return res;
+}
+
+// put the events into the ET system, returns a summary
+static ProducerReport produce(const std::vector<std::vector<uint32_t>> &events, const ReplayOptions &opt,
+                              et_sys_id et_id, et_att_id att_id)
+{
+    ProducerReport report{0, 0, 0.};
+    size_t total = events.size()*opt.nloops;
+    size_t max_words = opt.event_size/sizeof(uint32_t);
+    auto start = clk::now();
+
+    for (size_t iev = 0; iev < total; ++report.nblocks) {
+        // pace the producer
+        if (opt.rate > 0.) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<clk::duration>(
+                                            std::chrono::duration<double>(iev/opt.rate)));
+        }
+
+        et_event *pe;
+        if (et_event_new(et_id, att_id, &pe, ET_SLEEP, nullptr, opt.event_size) != ET_OK) {
+            std::cerr << "et_replay Error: failed to get a new ET event.\n";
+            break;
+        }
+        void *data;
+        et_event_getdata(pe, &data);
+        uint32_t *dbuf = static_cast<uint32_t*>(data);
+
+        // single event or a CODA block
+        size_t nwords = 0;
+        if (opt.block > 1) {
+            uint32_t nev = 0;
+            nwords = CODA_BLOCK_HEADER_SIZE;
+            for (; (nev < static_cast<uint32_t>(opt.block)) && (iev < total); ++nev, ++iev) {
+                auto &ev = events[iev % events.size()];
+                if (nwords + ev.size() > max_words) { break; }
+                std::copy(ev.begin(), ev.end(), dbuf + nwords);
+                nwords += ev.size();
+            }
+            uint32_t header[CODA_BLOCK_HEADER_SIZE] = {static_cast<uint32_t>(nwords),
+                                                       static_cast<uint32_t>(report.nblocks),
+                                                       CODA_BLOCK_HEADER_SIZE, nev, 0, 4, 0, CODA_BLOCK_MAGIC};
+            std::copy(header, header + CODA_BLOCK_HEADER_SIZE, dbuf);
+            report.nevents += nev;
+        } else {
+            auto &ev = events[iev % events.size()];
+            nwords = std::min(ev.size(), max_words);
+            std::copy(ev.begin(), ev.begin() + nwords, dbuf);
+            ++iev;
+            report.nevents++;
+        }
+
+        if (opt.swap) {
+            evc_swap32(dbuf, dbuf, nwords);
+            et_event_setendian(pe, ET_ENDIAN_NOTLOCAL);
+        }
+
+        // put time in the control words
+        int64_t now = clk::now().time_since_epoch().count();
+        int control[ET_STATION_SELECT_INTS] = {static_cast<int>(now & 0xFFFFFFFF), static_cast<int>(now >> 32),
+                                               0, 0, 0, 0};
+        et_event_setcontrol(pe, control, ET_STATION_SELECT_INTS);
+        et_event_setlength(pe, nwords*sizeof(uint32_t));
+        et_event_put(et_id, att_id, pe);
+    }
+
+    report.time = std::chrono::duration<double>(clk::now() - start).count();
+    return report;
+}
+
+// start the ET system and the producer in a child process, it runs until the parent sends SIGTERM
+static pid_t fork_producer(const std::vector<std::vector<uint32_t>> &events, const ReplayOptions &opt,
+                           int go_fd, int report_fd)
+{
+    // clean up the leftover from a previous run
+    unlink(opt.et_file.c_str());
+
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    // do not outlive the parent
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    et_sysconfig config;
+    et_sys_id sys_id;
+    et_system_config_init(&config);
+    et_system_config_setevents(config, opt.nevents);
+    et_system_config_setsize(config, opt.event_size);
+    et_system_config_setfile(config, opt.et_file.c_str());
+    et_system_config_setserverport(config, opt.port);
+    et_system_config_setstations(config, 10);
+    et_system_config_setattachments(config, 20);
+
+    if (et_system_start(&sys_id, config) != ET_OK) {
+        std::cerr << "et_replay Error: failed to start the ET system.\n";
+        _exit(-1);
+    }
+    et_system_config_destroy(config);
+
+    // wait for the consumer station
+    ProducerReport report{0, 0, 0.};
+    char go = 0;
+    et_att_id att_id;
+    if ((read(go_fd, &go, 1) == 1) && (et_station_attach(sys_id, ET_GRANDCENTRAL, &att_id) == ET_OK)) {
+        report = produce(events, opt, sys_id, att_id);
+        et_station_detach(sys_id, att_id);
+    } else {
+        std::cerr << "et_replay Error: producer cannot attach to the ET system.\n";
+    }
+    if (write(report_fd, &report, sizeof(report)) != sizeof(report)) {
+        std::cerr << "et_replay Error: failed to send the producer report.\n";
+    }
+
+    // keep the ET system alive until the consumer is done
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGTERM);
+    sigprocmask(SIG_BLOCK, &sigs, nullptr);
+    int sig;
+    sigwait(&sigs, &sig);
+
+    et_system_close(sys_id);
+    _exit(0);
+}
+
+static double percentile(std::vector<double> &vals, double p)
+{
+    if (vals.empty()) { return 0.; }
+    size_t n = std::min(vals.size() - 1, static_cast<size_t>(p*vals.size()));
+    std::nth_element(vals.begin(), vals.begin() + n, vals.end());
+    return vals[n];
+}
+
+// consume the events with EtChannel and report the performance
+static void consume(const ReplayOptions &opt, int go_fd, int report_fd)
+{
+    std::vector<double> latencies;
+    uint64_t received = 0, consumed = 0, words = 0;
+
+    evc::EtChannel etchan;
+    etchan.GetConfig().set_cue(opt.cue);
+    if (opt.chunk > 0) {
+        etchan.SetChunkSize(opt.chunk);
+    } else if (opt.chunk < 0) {
+        etchan.SetAutoChunk(true, opt.cue);
+    }
+    if (opt.prescale > 1) {
+        etchan.SetAdaptivePrescale(true, opt.prescale);
+    }
+    if (!opt.stats_file.empty()) {
+        etchan.SetStatsFile(opt.stats_file, 1.);
+    }
+    etchan.SetEtEventHook([&latencies, &received] (et_event *pe) {
+            auto now = clk::now();
+            int control[ET_STATION_SELECT_INTS];
+            et_event_getcontrol(pe, control);
+            int64_t put = (static_cast<int64_t>(control[1]) << 32) | static_cast<uint32_t>(control[0]);
+            latencies.push_back(std::chrono::duration<double, std::micro>(now - clk::time_point(clk::duration(put))).count());
+            received++;
+        });
+
+    // the ET system is started by the producer process, wait for it
+    auto wait_start = clk::now();
+    while (etchan.Connect("localhost", opt.port, opt.et_file) != evc::status::success) {
+        if (clk::now() - wait_start > std::chrono::seconds(10)) {
+            std::cerr << "et_replay Error: consumer cannot connect to the ET system.\n";
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (etchan.Open(opt.station) != evc::status::success) {
+        std::cerr << "et_replay Error: consumer cannot attach to the ET system.\n";
+        return;
+    }
+
+    // start the producer
+    char go = 1;
+    if (write(go_fd, &go, 1) != 1) {
+        std::cerr << "et_replay Error: failed to start the producer.\n";
+        return;
+    }
+
+    ProducerReport report{0, 0, 0.};
+    bool producer_done = false;
+    auto start = clk::now(), last = start;
+    while (true) {
+        auto status = etchan.Read();
+        if (status == evc::status::success) {
+            consumed++;
+            words += etchan.GetEvHeader().length + 1;
+            if (opt.scan) {
+                etchan.ScanBanks();
+                etchan.MarkStage(evc::Stage::Decode);
+            }
+            last = clk::now();
+        } else if (status == evc::status::empty) {
+            if (!producer_done) {
+                pollfd pfd{report_fd, POLLIN, 0};
+                if (poll(&pfd, 1, 0) > 0) {
+                    producer_done = (read(report_fd, &report, sizeof(report)) == sizeof(report));
+                    if (!producer_done) { break; }
+                }
+            // drained
+            } else if (clk::now() - last > std::chrono::milliseconds(500)) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        } else {
+            break;
+        }
+    }
+    double time = std::chrono::duration<double>(last - start).count();
+    uint64_t nprescaled = etchan.GetNPrescaled();
+    etchan.Disconnect();
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Producer: " << report.nevents << " events in " << report.nblocks << " ET events, "
+              << report.time << " s, " << report.nevents/report.time << " events/s\n"
+              << "Consumer: " << consumed << " events in " << received << " ET events, "
+              << time << " s, " << consumed/time << " events/s, " << words*4e-6/time << " MB/s\n"
+              << "Dropped: " << report.nblocks - received << " ET events ("
+              << 100.*(report.nblocks - received)/std::max<uint64_t>(report.nblocks, 1) << "%)\n"
+              << "Prescaled: " << nprescaled << " physics events\n"
+              << "Latency (put to get, us): p50 = " << percentile(latencies, 0.50)
+              << ", p90 = " << percentile(latencies, 0.90)
+              << ", p99 = " << percentile(latencies, 0.99)
+              << ", max = " << percentile(latencies, 1.0)
+              << std::endl;
+}
@@ -1,6 +1,8 @@
 #include "EtChannel.h"
+#include "EvSwap.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 using namespace evc;
 
@@ -19,8 +21,19 @@ static inline status et_status(int code, bool verbose = false)
 }
 
 
+// CODA physics events (built trigger banks)
+static inline bool coda_physics(const BankHeader &header)
+{
+    return (header.tag >= 0xff50) && (header.tag < 0xff90);
+}
+
 EtChannel::EtChannel(size_t chunk_buf)
-: EvChannel(0), et_id(nullptr), stat_id(ID_NULL), att_id(ID_NULL)
+: EvChannel(0), et_id(nullptr), stat_id(ID_NULL), att_id(ID_NULL),
+  auto_chunk(false), chunk_size(0), max_chunk(chunk_buf), target_latency(0.05), call_time(0.),
+  auto_prescale(false), prescale(1), max_prescale(1), high_water(0.75), low_water(0.25),
+  backlog(0.), proc_rate(0.), nphysics(0), nprescaled(0), nproc(0),
+  rate_time(std::chrono::steady_clock::now()), is_physics(coda_physics),
+  enable_stats(true), delivered(false), stats_interval(10.), last_dump(rate_time), get_time(rate_time)
 {
     // large enough chunk
     pe.resize(chunk_buf);
@@ -49,6 +62,9 @@ status EtChannel::Connect(const std::string &ip, int port, const std::string &et
     char *fname = strdup(et_file.c_str());
     auto status = et_open(&et_id, fname, conf.configure().get());
     free(fname);
+    if (status != ET_OK) {
+        et_id = nullptr;
+    }
     return et_status(status, true);
 }
 
@@ -90,35 +106,214 @@ void EtChannel::Disconnect()
     }
 }
 
+void EtChannel::SetAutoChunk(bool enable, int max_n, double latency)
+{
+    auto_chunk = enable;
+    max_chunk = std::max(max_n, 1);
+    target_latency = latency;
+    chunk_size = std::min(GetChunkSize(), max_chunk);
+}
+
+// tune the chunk size after a fetch
+void EtChannel::tuneChunk(int nread, double dt)
+{
+    // average overhead of an et_events_get call
+    call_time = (call_time > 0.) ? 0.9*call_time + 0.1*dt : dt;
+
+    if (!auto_chunk) {
+        return;
+    }
+
+    int chunk = GetChunkSize();
+    // more events are waiting in the queue, grow it to amortize the call overhead
+    if ((nread >= chunk) || (backlog > high_water)) {
+        chunk *= 2;
+    // the queue is mostly empty, a large chunk does not help
+    } else if (nread < chunk/4) {
+        chunk /= 2;
+    }
+
+    // the last event in a chunk waits chunk/rate seconds in the local buffer, keep it below the target latency,
+    // unless the call overhead itself is comparable to that (no point to go below it)
+    if (proc_rate > 0.) {
+        int lat_cap = static_cast<int>(proc_rate*std::max(target_latency, 10.*call_time));
+        chunk = std::min(chunk, lat_cap);
+    }
+    chunk_size = std::max(1, std::min(chunk, max_chunk));
+}
+
+void EtChannel::SetAdaptivePrescale(bool enable, uint32_t max_ps, double high, double low)
+{
+    auto_prescale = enable;
+    max_prescale = std::max(max_ps, 1u);
+    high_water = high;
+    low_water = low;
+    prescale = 1;
+}
+
+// adjust the prescale factor according to the backlog, called before fetching a new chunk
+void EtChannel::updatePrescale()
+{
+    // processing rate, averaged over at least 0.5 second
+    auto now = std::chrono::steady_clock::now();
+    double dt = std::chrono::duration<double>(now - rate_time).count();
+    if (dt > 0.5) {
+        proc_rate = (proc_rate > 0.) ? 0.5*(proc_rate + nproc/dt) : nproc/dt;
+        nproc = 0;
+        rate_time = now;
+    }
+
+    if (!auto_prescale && !auto_chunk) {
+        return;
+    }
+
+    // events waiting in the station, it is the backlog the non-blocking station drops from
+    int count = 0;
+    if (et_station_getinputcount(et_id, stat_id, &count) != ET_OK) {
+        return;
+    }
+    backlog = count/static_cast<double>(std::max(sconf.get_cue(), 1));
+
+    if (!auto_prescale) {
+        return;
+    }
+
+    // double or halve it, the gap between the water marks prevents thrashing
+    if ((backlog > high_water) && (prescale < max_prescale)) {
+        prescale = std::min(prescale*2, max_prescale);
+    } else if ((backlog < low_water) && (prescale > 1)) {
+        prescale /= 2;
+    }
+}
+
+// deterministic sampling of physics events
+bool EtChannel::passPrescale(const BankHeader &header)
+{
+    if ((prescale <= 1) || !is_physics(header)) {
+        return true;
+    }
+    if ((nphysics++ % prescale) == 0) {
+        return true;
+    }
+    nprescaled++;
+    return false;
+}
+
+void EtChannel::SetStatsFile(const std::string &path, double interval)
+{
+    if (stats_file.is_open()) {
+        stats_file.close();
+    }
+    stats_interval = interval;
+    if (!path.empty()) {
+        stats_file.open(path, std::ios::out | std::ios::app);
+        if (!stats_file.is_open()) {
+            std::cerr << "EtChannel Error: cannot open stats file " << path << "\n";
+        }
+    }
+    stats.Reset();
+    last_dump = std::chrono::steady_clock::now();
+}
+
+// one line per stage per interval, the histograms are reset after dumping
+void EtChannel::dumpStats(std::chrono::steady_clock::time_point now)
+{
+    if (!stats_file.is_open() || (std::chrono::duration<double>(now - last_dump).count() < stats_interval)) {
+        return;
+    }
+    last_dump = now;
+
+    auto epoch = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+    stats_file << epoch
+               << " rate=" << stats.Throughput()
+               << " events=" << stats.nevents
+               << " et_events=" << stats.net_events
+               << " chunks=" << stats.nchunks
+               << " backlog=" << backlog
+               << " chunk=" << GetChunkSize()
+               << " prescale=" << prescale << "\n";
+    for (int i = 0; i < static_cast<int>(Stage::Max); ++i) {
+        auto &h = stats.ages[i];
+        if (!h.Count()) { continue; }
+        stats_file << epoch << " " << Stage2str(static_cast<Stage>(i))
+                   << " n=" << h.Count()
+                   << " mean=" << h.Mean()
+                   << " p50=" << h.Percentile(0.5)
+                   << " p90=" << h.Percentile(0.9)
+                   << " p99=" << h.Percentile(0.99) << "\n";
+    }
+    stats_file << std::flush;
+    stats.Reset();
+}
+
+// record the age of the current event (or n buffered events) at a pipeline stage
+void EtChannel::MarkStage(Stage s, uint64_t n)
+{
+    if (!enable_stats) { return; }
+    stats.Age(s).Fill(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - get_time).count(), n);
+}
+
+// move the front of the local buffers to the event buffer
+inline void EtChannel::popBuffer()
+{
+    buffer = std::move(buffers.front());
+    buffers.pop_front();
+    nproc++;
+    stats.nevents++;
+    MarkStage(Stage::Deliver);
+    delivered = true;
+}
+
 // read an event
 status EtChannel::Read()
 {
+    // the consumer is done with the previous event
+    if (delivered) {
+        MarkStage(Stage::Done);
+        delivered = false;
+    }
+
     // buffers are not empty, just get the first element from it
     if (!buffers.empty()) {
-        buffer = std::move(buffers.front());
-        buffers.pop_front();
+        popBuffer();
         return status::success;
     // read from ET system
     } else {
+        updatePrescale();
         int nread = 0;
-        int chunk = sconf.get_cue();
+        int chunk = GetChunkSize();
         if (chunk > static_cast<int>(pe.size())) {
             pe.resize(chunk);
         }
+        auto t0 = std::chrono::steady_clock::now();
         auto status = et_events_get(et_id, att_id, &pe[0], ET_ASYNC, nullptr, chunk, &nread);
+        get_time = std::chrono::steady_clock::now();
+        tuneChunk((status == ET_OK) ? nread : 0, std::chrono::duration<double>(get_time - t0).count());
+        if (enable_stats) {
+            dumpStats(get_time);
+        }
 
         switch (status) {
         case ET_OK:
             if (!copyEvent(&pe[0], nread)) {
                 return status::empty;
             }
+            stats.nchunks++;
+            stats.net_events += nread;
+            MarkStage(Stage::Copy, buffers.size());
             if (et_events_put(et_id, att_id, &pe[0], nread) != ET_OK) {
                 std::cerr << "EtChannel Error: failed to put back et_event after reading.\n";
                 return status::eof;
             }
+            MarkStage(Stage::Release, buffers.size());
+            // all events are filtered out
+            if (buffers.empty()) {
+                return status::empty;
+            }
             // get an event from the buffers
-            buffer = std::move(buffers.front());
-            buffers.pop_front();
+            popBuffer();
             break;
         case ET_ERROR_BUSY:
         case ET_ERROR_TIMEOUT:
@@ -145,11 +340,16 @@ inline bool ev_filter(Func beg, Func end, Args&&... args)
     return true;
 }
 
-template<class Func>
-std::vector<uint32_t> copy_event(const uint32_t *buf, bool swap, Func fil_beg, Func fil_end)
+template<class Func, class Prescale>
+std::vector<uint32_t> copy_event(const uint32_t *buf, bool swap, Func fil_beg, Func fil_end, Prescale &&pass_prescale)
 {
     std::vector<uint32_t> event;
-    auto header = BankHeader(buf);
+    uint32_t hwords[2] = {buf[0], buf[1]};
+    if (swap) {
+        hwords[0] = ET_SWAP32(hwords[0]);
+        hwords[1] = ET_SWAP32(hwords[1]);
+    }
+    auto header = BankHeader(hwords);
 
     // invalid header
     if (header.length < 1) {
@@ -163,12 +363,17 @@ std::vector<uint32_t> copy_event(const uint32_t *buf, bool swap, Func fil_beg, F
         }
     }
 
-    // good event, copy it!
-    event.assign(buf, buf + header.length + 1);
+    // prescaled
+    if (!pass_prescale(header)) {
+        return event;
+    }
+
+    // good event, copy it! swap it in the same pass if needed
     if (swap) {
-        for (auto &val : event) {
-            val = ET_SWAP32(val);
-        }
+        event.resize(header.length + 1);
+        evc_swap32(buf, &event[0], event.size());
+    } else {
+        event.assign(buf, buf + header.length + 1);
     }
 
     return event;
@@ -184,8 +389,12 @@ bool EtChannel::copyEvent(et_event **pe, int nread)
     void *data;
     size_t len, bytes = sizeof(uint32_t);
     int endian, swap;
+    auto pass = [this] (const BankHeader &header) { return passPrescale(header); };
 
     for (int i = 0; i < nread; ++i) {
+        if (et_hook) {
+            et_hook(pe[i]);
+        }
         // get event data and attributes from ET
         et_event_getdata(pe[i], &data);
         et_event_getlength(pe[i], &len);
@@ -200,16 +409,17 @@ bool EtChannel::copyEvent(et_event **pe, int nread)
         if ((len > 6) && (0xc0da0100 == (swap ? ET_SWAP32(dbuf[7]) : dbuf[7]))) {
             // skip the block header (size 8)
             uint32_t index = 8;
-            while (index < dbuf[0]) {
-                auto event = copy_event(&dbuf[index], swap, filters.begin(), filters.end());
-                index += dbuf[index] + 1;
+            uint32_t blen = swap ? ET_SWAP32(dbuf[0]) : dbuf[0];
+            while (index < blen) {
+                auto event = copy_event(&dbuf[index], swap, filters.begin(), filters.end(), pass);
+                index += (swap ? ET_SWAP32(dbuf[index]) : dbuf[index]) + 1;
                 if (event.size()) {
                     buffers.emplace_back(std::move(event));
                 }
             }
         // a single event
         } else {
-            auto event = copy_event(dbuf, swap, filters.begin(), filters.end());
+            auto event = copy_event(dbuf, swap, filters.begin(), filters.end(), pass);
             if (event.size()) {
                 buffers.emplace_back(std::move(event));
             }
@@ -9,10 +9,12 @@
 #pragma once
 
 #include "EtConfigWrapper.h"
+#include "EtStats.h"
 #include "EvChannel.h"
 #include "EvStruct.h"
 #include <functional>
 #include <iostream>
+#include <fstream>
 #include <chrono>
 #include <string>
 #include <thread>
@@ -41,12 +43,46 @@ public:
     void Disconnect();
     bool IsETOpen() const { return (et_id != nullptr) && et_alive(et_id); }
     void AddEvFilter(std::function<bool(const BankHeader &)> &&func) { filters.emplace_back(func); }
+    // called for every et_event fetched from the station, before its data is copied
+    void SetEtEventHook(std::function<void(et_event *)> &&func) { et_hook = func; }
 
     et_wrap::StationConfig &GetConfig() { return sconf; }
     const et_wrap::StationConfig &GetConfig() const { return sconf; }
 
+    // number of events requested per et_events_get, it is the station cue if not set
+    void SetChunkSize(int n) { chunk_size = n; auto_chunk = false; }
+    // tune the chunk size between [1, max_chunk] with the per-call overhead, the queue occupancy and a target
+    // latency (seconds) that an event may wait in the local buffer
+    void SetAutoChunk(bool enable, int max_chunk = 1000, double target_latency = 0.05);
+    int GetChunkSize() const { return (chunk_size > 0) ? chunk_size : sconf.get_cue(); }
+
+    // adaptive prescale, when the consumer falls behind only 1 of every N physics events is decoded
+    // other events (control, sync, scalers...) are always kept
+    void SetAdaptivePrescale(bool enable, uint32_t max_prescale = 64,
+                             double high_water = 0.75, double low_water = 0.25);
+    void SetPhysicsSelector(std::function<bool(const BankHeader &)> &&func) { is_physics = func; }
+    uint32_t GetPrescale() const { return prescale; }
+    uint64_t GetNPrescaled() const { return nprescaled; }
+    // occupancy of the station input queue (fraction of cue) at the last fetch
+    double GetBacklog() const { return backlog; }
+    // events returned by Read() per second
+    double GetProcessRate() const { return proc_rate; }
+
+    // event-age statistics, ages are measured from et_events_get of the current event
+    void EnableStats(bool enable) { enable_stats = enable; }
+    void MarkStage(Stage s, uint64_t n = 1);
+    const EtStats &GetStats() const { return stats; }
+    void ResetStats() { stats.Reset(); }
+    // append the statistics to a file every interval seconds (and reset them), empty path to stop
+    void SetStatsFile(const std::string &path, double interval = 10.);
+
 private:
     bool copyEvent(et_event **pe, int nread);
+    void popBuffer();
+    void dumpStats(std::chrono::steady_clock::time_point now);
+    void updatePrescale();
+    void tuneChunk(int nread, double call_time);
+    bool passPrescale(const BankHeader &header);
 
     et_wrap::StationConfig sconf;
     et_sys_id et_id;
@@ -54,7 +90,28 @@ private:
     et_att_id att_id;
     std::list<std::vector<uint32_t>> buffers;
     std::vector<std::function<bool(const BankHeader &)>> filters;
+    std::function<void(et_event *)> et_hook;
     std::vector<et_event*> pe;
+
+    // chunk size
+    bool auto_chunk;
+    int chunk_size, max_chunk;
+    double target_latency, call_time;
+
+    // adaptive prescale
+    bool auto_prescale;
+    uint32_t prescale, max_prescale;
+    double high_water, low_water, backlog, proc_rate;
+    uint64_t nphysics, nprescaled, nproc;
+    std::chrono::steady_clock::time_point rate_time;
+    std::function<bool(const BankHeader &)> is_physics;
+
+    // statistics, all the buffered events come from the same et_events_get
+    bool enable_stats, delivered;
+    double stats_interval;
+    std::chrono::steady_clock::time_point last_dump, get_time;
+    EtStats stats;
+    std::ofstream stats_file;
 };
 
 }   // namespace evc
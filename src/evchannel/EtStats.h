@@ -0,0 +1,121 @@
+//=============================================================================
+// EtStats                                                                   ||
+// Event-age and throughput statistics for the ET consumption                ||
+// Ages are measured from et_events_get, histograms have fixed log bins so   ||
+// filling them costs a few instructions and no allocation                   ||
+//=============================================================================
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <string>
+
+
+namespace evc {
+
+// pipeline stages, the age of an event (since et_events_get) is recorded at each of them
+enum class Stage : int
+{
+    Copy = 0,   // copied out of the ET event
+    Release,    // ET events put back to the station
+    Deliver,    // returned by Read()
+    Decode,     // marked by user
+    Analyze,    // marked by user
+    Fill,       // marked by user
+    Done,       // the next Read() is called
+    Max,
+};
+
+inline const char *Stage2str(Stage s)
+{
+    switch (s) {
+    case Stage::Copy: return "copy";
+    case Stage::Release: return "release";
+    case Stage::Deliver: return "deliver";
+    case Stage::Decode: return "decode";
+    case Stage::Analyze: return "analyze";
+    case Stage::Fill: return "fill";
+    case Stage::Done: return "done";
+    default: return "unknown";
+    }
+}
+
+// histogram in ns with 4 bins per octave, covers up to ~1000 s
+class AgeHistogram
+{
+public:
+    static const int nsub = 4;
+    static const int nbins = 40*nsub;
+
+    AgeHistogram() { Reset(); }
+
+    void Reset() { std::memset(bins, 0, sizeof(bins)); count = 0; sum = 0.; }
+
+    void Fill(int64_t ns, uint64_t n = 1)
+    {
+        bins[index(ns)] += n;
+        count += n;
+        sum += static_cast<double>(ns)*n;
+    }
+
+    uint64_t Count() const { return count; }
+    // in us
+    double Mean() const { return count ? sum/count*1e-3 : 0.; }
+    double Percentile(double p) const
+    {
+        if (!count) { return 0.; }
+        uint64_t target = static_cast<uint64_t>(p*count), acc = 0;
+        for (int i = 0; i < nbins; ++i) {
+            acc += bins[i];
+            if (acc > target) { return center(i)*1e-3; }
+        }
+        return center(nbins - 1)*1e-3;
+    }
+
+private:
+    static int index(int64_t ns)
+    {
+        if (ns < 2) { return 0; }
+        int octave = 63 - __builtin_clzll(static_cast<uint64_t>(ns));
+        int sub = (octave >= 2) ? static_cast<int>((ns >> (octave - 2)) & (nsub - 1)) : 0;
+        int i = octave*nsub + sub;
+        return (i < nbins) ? i : nbins - 1;
+    }
+
+    static double center(int i)
+    {
+        int octave = i/nsub, sub = i % nsub;
+        return static_cast<double>(1ULL << octave)*(1. + (sub + 0.5)/nsub);
+    }
+
+    uint64_t bins[nbins];
+    uint64_t count;
+    double sum;
+};
+
+struct EtStats
+{
+    AgeHistogram ages[static_cast<int>(Stage::Max)];
+    uint64_t nchunks = 0, net_events = 0, nevents = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    AgeHistogram &Age(Stage s) { return ages[static_cast<int>(s)]; }
+    const AgeHistogram &Age(Stage s) const { return ages[static_cast<int>(s)]; }
+
+    // delivered events per second since the last reset
+    double Throughput() const
+    {
+        double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return (dt > 0.) ? nevents/dt : 0.;
+    }
+
+    void Reset()
+    {
+        for (auto &h : ages) { h.Reset(); }
+        nchunks = net_events = nevents = 0;
+        start = std::chrono::steady_clock::now();
+    }
+};
+
+} // namespace evc
@@ -0,0 +1,93 @@
+/*=============================================================================
+ * EvSwap                                                                    ||
+ * Bulk 32-bit endian swap, shared by the evio (C) and ET (C++) paths        ||
+ * AVX2/SSSE3 kernels are selected at runtime, with a scalar fallback        ||
+ * evc_swap32 also works as a fused copy-and-swap when src != dst            ||
+ *===========================================================================*/
+#ifndef EVC_SWAP_H
+#define EVC_SWAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define EVC_SWAP_X86 1
+#include <immintrin.h>
+#endif
+
+/* below this length the dispatch does not pay off */
+#define EVC_SWAP_MIN_SIMD 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint32_t evc_swap32_word(uint32_t x)
+{
+    return ((x >> 24) & 0x000000FF) | ((x >> 8) & 0x0000FF00) | ((x << 8) & 0x00FF0000) | ((x << 24) & 0xFF000000);
+}
+
+static inline void evc_swap32_scalar(const uint32_t *src, uint32_t *dst, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        dst[i] = evc_swap32_word(src[i]);
+    }
+}
+
+#ifdef EVC_SWAP_X86
+__attribute__((target("ssse3")))
+static inline void evc_swap32_ssse3(const uint32_t *src, uint32_t *dst, size_t n)
+{
+    const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    evc_swap32_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline void evc_swap32_avx2(const uint32_t *src, uint32_t *dst, size_t n)
+{
+    const __m256i mask = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                         12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(src + i + 8));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_shuffle_epi8(v0, mask));
+        _mm256_storeu_si256((__m256i *)(dst + i + 8), _mm256_shuffle_epi8(v1, mask));
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_shuffle_epi8(v, mask));
+    }
+    evc_swap32_scalar(src + i, dst + i, n - i);
+}
+#endif
+
+/* swap n 32-bit words from src to dst, src == dst swaps in place, other overlaps are not allowed */
+static inline void evc_swap32(const uint32_t *src, uint32_t *dst, size_t n)
+{
+#ifdef EVC_SWAP_X86
+    if (n >= EVC_SWAP_MIN_SIMD) {
+        if (__builtin_cpu_supports("avx2")) {
+            evc_swap32_avx2(src, dst, n);
+            return;
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+            evc_swap32_ssse3(src, dst, n);
+            return;
+        }
+    }
+#endif
+    evc_swap32_scalar(src, dst, n);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVC_SWAP_H */
@@ -73,6 +73,7 @@
 /* include files */
 #include <stdio.h>
 #include "evio.h"
+#include "EvSwap.h"
 
 
 /* from Sergey's composite swap library */
@@ -374,16 +375,13 @@ int32_t swap_int32_t_value(int32_t val) {
  */
 uint32_t *swap_int32_t(uint32_t *data, unsigned int length, uint32_t *dest) {
 
-    unsigned int i;
-
     if (dest == NULL) {
         dest = data;
     }
 
-    for (i=0; i < length; i++) {
-        dest[i] = EVIO_SWAP32(data[i]);
-    }
-    
+    /* SIMD kernel shared with the ET path */
+    evc_swap32(data, dest, length);
+
     return(dest);
 }
 
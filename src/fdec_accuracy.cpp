@@ -0,0 +1,161 @@
+//=============================================================================
+// fdec_accuracy                                                             ||
+// Accuracy of the single-precision waveform analyzer (fdec::AnalyzerF)      ||
+// against the double-precision one on recorded FADC250 data                 ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <vector>
+#include <string>
+#include "EvChannel.h"
+#include "ConfigArgs.h"
+#include "Fadc250Decoder.h"
+#include "WfAnalyzer.h"
+
+#define CODA_PRST 0xffd1
+#define CODA_GO 0xffd2
+#define CODA_END 0xffd4
+
+
+// absolute differences of a quantity
+struct DiffStat
+{
+    uint64_t n = 0, nexact = 0;
+    double max = 0., sum2 = 0., max_rel = 0.;
+
+    void Fill(double ref, double val)
+    {
+        double diff = std::abs(val - ref);
+        n++;
+        nexact += (diff == 0.);
+        sum2 += diff*diff;
+        max = std::max(max, diff);
+        if (ref != 0.) { max_rel = std::max(max_rel, diff/std::abs(ref)); }
+    }
+
+    double RMS() const { return n ? std::sqrt(sum2/n) : 0.; }
+};
+
+struct AccuracyReport
+{
+    uint64_t nwaveforms = 0, npeaks = 0, npeaks_float = 0, nmismatch = 0;
+    DiffStat ped_mean, ped_err, height, integral, time;
+
+    void Compare(const fdec::Fadc250Data &ref, const fdec::Fadc250Data &val);
+    void Print(std::ostream &os) const;
+};
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddPositional("raw_data",
+            "raw data in evio format");
+    arg_parser.AddArg<int>("-n", "nev",
+            "number of events to process (< 0 means all)", -1);
+    arg_parser.AddArg<int>("-r", "res",
+            "resolution for waveform analysis", 3);
+    arg_parser.AddArg<double>("-t", "thres",
+            "peak threshold for waveform analysis", 20.0);
+    arg_parser.AddArg<int>("-p", "npeds",
+            "sample window width for pedestal searching", 8);
+    arg_parser.AddArg<double>("-f", "flat",
+            "flatness requirement for pedestal searching", 1.0);
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    evc::EvChannel evchan;
+    if (evchan.Open(args["raw_data"].String()) != evc::status::success) {
+        std::cout << "Cannot open evchannel at " << args["raw_data"].String() << std::endl;
+        return -1;
+    }
+
+    int res = args["res"].Int(), npeds = args["npeds"].Int(), nev = args["nev"].Int();
+    double thres = args["thres"].Double(), flat = args["flat"].Double();
+    fdec::Analyzer ana(res, thres, npeds, flat);
+    fdec::AnalyzerF ana_float(res, thres, npeds, flat);
+    fdec::AnalyzerWorkspace ws;
+    fdec::AnalyzerWorkspaceF ws_float;
+
+    // all the uint32 banks are taken as FADC250 data
+    fdec::Fadc250Decoder decoder;
+    std::vector<fdec::Fadc250Event> events;
+    fdec::Fadc250Data data_float;
+    AccuracyReport report;
+    while ((evchan.Read() == evc::status::success) && (nev-- != 0)) {
+        auto tag = evchan.GetEvHeader().tag;
+        if ((tag == CODA_PRST) || (tag == CODA_GO) || (tag == CODA_END)) {
+            continue;
+        }
+
+        auto buf = evchan.GetRawBuffer();
+        for (auto &bank : evchan.ScanBanks()) {
+            if ((bank.type != evc::DATA_UINT32) && (bank.type != evc::DATA_UNKNOWN32)) {
+                continue;
+            }
+            size_t n = decoder.DecodeBlock(events, buf + bank.buf_loc + 2, bank.length - 1);
+            for (size_t i = 0; i < n; ++i) {
+                for (auto &ch : events[i].channels) {
+                    if (ch.raw.empty()) { continue; }
+                    data_float.raw = ch.raw;
+                    ana.Analyze(ch, ws);
+                    ana_float.Analyze(data_float, ws_float);
+                    report.Compare(ch, data_float);
+                }
+            }
+        }
+    }
+    evchan.Close();
+
+    report.Print(std::cout);
+    if (decoder.GetStats().Total()) {
+        decoder.PrintStats();
+    }
+    return 0;
+}
+
+// peaks are compared when both analyzers find the same peaks (positions) in a waveform
+void AccuracyReport::Compare(const fdec::Fadc250Data &ref, const fdec::Fadc250Data &val)
+{
+    nwaveforms++;
+    npeaks += ref.peaks.size();
+    npeaks_float += val.peaks.size();
+    ped_mean.Fill(ref.ped.mean, val.ped.mean);
+    ped_err.Fill(ref.ped.err, val.ped.err);
+
+    bool match = (ref.peaks.size() == val.peaks.size());
+    for (size_t i = 0; match && (i < ref.peaks.size()); ++i) {
+        match = (ref.peaks[i].pos == val.peaks[i].pos);
+    }
+    if (!match) {
+        nmismatch++;
+        return;
+    }
+
+    for (size_t i = 0; i < ref.peaks.size(); ++i) {
+        height.Fill(ref.peaks[i].height, val.peaks[i].height);
+        integral.Fill(ref.peaks[i].integral, val.peaks[i].integral);
+        time.Fill(ref.peaks[i].time, val.peaks[i].time);
+    }
+}
+
+void AccuracyReport::Print(std::ostream &os) const
+{
+    os << "Waveforms: " << nwaveforms << ", peaks (double/float): " << npeaks << "/" << npeaks_float
+       << ", waveforms with different peaks: " << nmismatch << std::endl;
+    os << std::setw(12) << "quantity" << std::setw(12) << "compared" << std::setw(12) << "exact"
+       << std::setw(14) << "max |diff|" << std::setw(14) << "rms diff" << std::setw(14) << "max rel" << std::endl;
+    auto print = [&os] (const std::string &name, const DiffStat &stat) {
+        os << std::setw(12) << name << std::setw(12) << stat.n << std::setw(12) << stat.nexact
+           << std::setprecision(3) << std::scientific
+           << std::setw(14) << stat.max << std::setw(14) << stat.RMS() << std::setw(14) << stat.max_rel
+           << std::defaultfloat << std::endl;
+    };
+    print("ped mean", ped_mean);
+    print("ped err", ped_err);
+    print("height", height);
+    print("integral", integral);
+    print("time (ns)", time);
+}
@@ -0,0 +1,133 @@
+//=============================================================================
+// fdec_alloc                                                                ||
+// Heap allocations of the FADC250 decoder in the steady state, the events  ||
+// are reused so decoding the same blocks again should not allocate        ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <new>
+#include <cstdlib>
+#include "ConfigArgs.h"
+#include "Fadc250Decoder.h"
+#include "Fadc250Generator.h"
+
+
+// count every allocation of the program
+static uint64_t nallocs = 0;
+
+void *operator new(size_t size)
+{
+    nallocs++;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+// slot blocks in one buffer
+struct BlockData
+{
+    std::vector<uint32_t> words;
+    std::vector<size_t> offsets;
+
+    size_t Size(size_t i) const { return ((i + 1 < offsets.size()) ? offsets[i + 1] : words.size()) - offsets[i]; }
+};
+
+static BlockData generate(fdec::Fadc250GenConfig cfg, int nev);
+
+// allocations in the passes after the first one (warm-up)
+template<class Func>
+uint64_t count_allocs(const BlockData &data, int npasses, Func &&func)
+{
+    for (size_t i = 0; i < data.offsets.size(); ++i) {
+        func(&data.words[data.offsets[i]], data.Size(i));
+    }
+    uint64_t n0 = nallocs;
+    for (int p = 1; p < npasses; ++p) {
+        for (size_t i = 0; i < data.offsets.size(); ++i) {
+            func(&data.words[data.offsets[i]], data.Size(i));
+        }
+    }
+    return nallocs - n0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddArg<int>("-n", "nev",
+            "number of events per data mode", 2000);
+    arg_parser.AddArg<int>("-p", "npasses",
+            "decoding passes over the data, the first one is the warm-up", 3);
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    int nev = args["nev"].Int(), npasses = args["npasses"].Int();
+    const std::vector<std::pair<std::string, uint32_t>> modes = {
+        {"window", fdec::kGenWindowRaw},
+        {"pulse", fdec::kGenPulseIntegralTime},
+        {"pulse_raw", fdec::kGenPulseRaw | fdec::kGenPulseIntegralTime},
+        {"mixed", fdec::kGenWindowRaw | fdec::kGenPulseIntegralTime | fdec::kGenPulseRaw},
+    };
+
+    int nfailed = 0;
+    std::cout << std::setw(10) << "mode" << std::setw(8) << "block" << std::setw(16) << "event allocs"
+              << std::setw(16) << "flat allocs" << std::endl;
+    for (auto &mode : modes) {
+        for (uint32_t block_level : {1, 8}) {
+            fdec::Fadc250GenConfig cfg;
+            cfg.mode = mode.second;
+            cfg.block_level = block_level;
+            auto data = generate(cfg, nev);
+
+            fdec::Fadc250Decoder decoder;
+            std::vector<fdec::Fadc250Event> events;
+            auto nevent = count_allocs(data, npasses, [&] (const uint32_t *buf, size_t len) {
+                decoder.DecodeBlock(events, buf, len);
+            });
+            std::vector<fdec::Fadc250FlatEvent> flat_events;
+            auto nflat = count_allocs(data, npasses, [&] (const uint32_t *buf, size_t len) {
+                decoder.DecodeBlock(flat_events, buf, len);
+            });
+
+            std::cout << std::setw(10) << mode.first << std::setw(8) << block_level << std::setw(16) << nevent
+                      << std::setw(16) << nflat << std::endl;
+            if (decoder.GetStats().Total()) {
+                decoder.PrintStats();
+            }
+            nfailed += (nevent > 0) + (nflat > 0);
+        }
+    }
+
+    if (nfailed) {
+        std::cout << "FAILED: the decoder allocates in the steady state." << std::endl;
+        return 1;
+    }
+    std::cout << "No allocations in the steady state." << std::endl;
+    return 0;
+}
+
+BlockData generate(fdec::Fadc250GenConfig cfg, int nev)
+{
+    fdec::Fadc250Generator gen(cfg);
+    BlockData data;
+    while (gen.GetNEvents() < static_cast<uint32_t>(nev)) {
+        data.offsets.push_back(data.words.size());
+        gen.GenerateBlock(data.words);
+    }
+    return data;
+}
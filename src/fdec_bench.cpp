@@ -0,0 +1,217 @@
+//=============================================================================
+// fdec_bench                                                                ||
+// Decoder and waveform analyzer throughput on synthetic FADC250 data, so    ||
+// the performance can be tracked without real run files                    ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "evio.h"
+#include "ConfigArgs.h"
+#include "ConfigParser.h"
+#include "Fadc250Decoder.h"
+#include "Fadc250Generator.h"
+#include "WfAnalyzer.h"
+#include "WfBatch.h"
+
+using clk = std::chrono::steady_clock;
+
+#define CODA_PHY1 0xff50
+
+
+// slot blocks in one buffer
+struct BlockData
+{
+    std::vector<uint32_t> words;
+    std::vector<size_t> offsets;
+    uint32_t nevents = 0;
+
+    size_t Size(size_t i) const { return ((i + 1 < offsets.size()) ? offsets[i + 1] : words.size()) - offsets[i]; }
+};
+
+struct BenchResult
+{
+    double time = 1e30;
+    uint64_t nwords = 0, nevents = 0;
+};
+
+static BlockData generate(fdec::Fadc250GenConfig cfg, int nev);
+static void write_evio(const std::string &path, const BlockData &data, int crate, int bank);
+static void report(const std::string &mode, const std::string &name, const BenchResult &res);
+
+// best of nrep runs
+template<class Func>
+BenchResult bench(const BlockData &data, int nrep, Func &&func)
+{
+    BenchResult res;
+    for (int r = 0; r < nrep; ++r) {
+        auto t0 = clk::now();
+        uint64_t nevents = 0;
+        for (size_t i = 0; i < data.offsets.size(); ++i) {
+            nevents += func(&data.words[data.offsets[i]], data.Size(i));
+        }
+        double dt = std::chrono::duration<double>(clk::now() - t0).count();
+        res.time = std::min(res.time, dt);
+        res.nwords = data.words.size();
+        res.nevents = nevents;
+    }
+    return res;
+}
+
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddArg<int>("-n", "nev",
+            "number of events per data mode", 20000);
+    arg_parser.AddArg<int>("-r", "nrep",
+            "number of repeats, the best is reported", 5);
+    arg_parser.AddArgs<std::string>({"-m", "--modes"}, "modes",
+            "data modes to test: window, pulse, pulse_raw, mixed (separated by comma)",
+            "window,pulse,pulse_raw,mixed");
+    arg_parser.AddArg<int>("-b", "block",
+            "events per block (block level)", 1);
+    arg_parser.AddArg<int>("-s", "nsamples",
+            "samples of the window raw data", 100);
+    arg_parser.AddArgs<double>({"--pulse-prob"}, "pulse_prob",
+            "probability of a pulse in a channel", 0.3);
+    arg_parser.AddArgs<double>({"--pileup-prob"}, "pileup_prob",
+            "probability of a pile-up pulse", 0.05);
+    arg_parser.AddArgs<double>({"--noise"}, "noise",
+            "pedestal noise (rms) in adc counts", 2.);
+    arg_parser.AddArgs<std::string>({"-o", "--evio"}, "evio",
+            "write the generated data of each mode to <path>_<mode>.evio", "");
+    arg_parser.AddSwitches({"--no-analyzer"}, "no_analyzer",
+            "skip the waveform analyzer");
+    arg_parser.AddSwitches({"-z", "--zero-sup"}, "zero_sup",
+            "zero suppression, the waveforms without signal are not analyzed");
+    arg_parser.AddArg<int>("-t", "threads",
+            "threads for the batch waveform analysis (0 for all cores)", 1);
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    int nev = args["nev"].Int(), nrep = args["nrep"].Int();
+    std::cout << std::setw(10) << "mode" << std::setw(18) << "benchmark"
+              << std::setw(14) << "Mwords/s" << std::setw(14) << "kevents/s" << std::endl;
+
+    for (auto &mode : ConfigParser::split(args["modes"].String(), ",")) {
+        fdec::Fadc250GenConfig cfg;
+        if (mode == "window") {
+            cfg.mode = fdec::kGenWindowRaw;
+        } else if (mode == "pulse") {
+            cfg.mode = fdec::kGenPulseIntegralTime;
+        } else if (mode == "pulse_raw") {
+            cfg.mode = fdec::kGenPulseRaw | fdec::kGenPulseIntegralTime;
+        } else if (mode == "mixed") {
+            cfg.mode = fdec::kGenWindowRaw | fdec::kGenPulseIntegralTime;
+        } else {
+            std::cout << "Unknown data mode " << mode << ", skip it." << std::endl;
+            continue;
+        }
+        cfg.block_level = args["block"].Int();
+        cfg.nsamples = args["nsamples"].Int();
+        cfg.pulse_prob = args["pulse_prob"].Double();
+        cfg.pileup_prob = args["pileup_prob"].Double();
+        cfg.noise = args["noise"].Double();
+
+        auto data = generate(cfg, nev);
+        if (!args["evio"].String().empty()) {
+            write_evio(args["evio"].String() + "_" + mode + ".evio", data, 1, 3);
+        }
+
+        fdec::Fadc250Decoder decoder;
+        std::vector<fdec::Fadc250Event> events;
+        report(mode, "decode", bench(data, nrep, [&] (const uint32_t *buf, size_t len) {
+            return decoder.DecodeBlock(events, buf, len);
+        }));
+
+        std::vector<fdec::Fadc250FlatEvent> flat_events;
+        report(mode, "decode (flat)", bench(data, nrep, [&] (const uint32_t *buf, size_t len) {
+            return decoder.DecodeBlock(flat_events, buf, len);
+        }));
+
+        if (!(cfg.mode & fdec::kGenWindowRaw) || args["no_analyzer"].Bool()) {
+            continue;
+        }
+
+        fdec::Analyzer analyzer(3, 20., 8, 1.0);
+        analyzer.SetZeroSuppression(args["zero_sup"].Bool());
+        report(mode, "decode+analyze", bench(data, nrep, [&] (const uint32_t *buf, size_t len) {
+            auto n = decoder.DecodeBlock(events, buf, len);
+            for (size_t i = 0; i < n; ++i) {
+                for (auto &ch : events[i].channels) { analyzer.Analyze(ch); }
+            }
+            return n;
+        }));
+
+        // all the channels of a block in one batch, larger blocks (-b) make larger batches
+        fdec::WfBatchAnalyzer batch_analyzer(analyzer, args["threads"].Int());
+        fdec::WfBatch batch;
+        fdec::WfBatchResult batch_res;
+        report(mode, "decode+batch", bench(data, nrep, [&] (const uint32_t *buf, size_t len) {
+            auto n = decoder.DecodeBlock(flat_events, buf, len);
+            batch.Clear();
+            batch.Add(flat_events, n);
+            batch_analyzer.Analyze(batch, batch_res);
+            return n;
+        }));
+
+        if (decoder.GetStats().Total()) {
+            decoder.PrintStats();
+        }
+    }
+
+    return 0;
+}
+
+BlockData generate(fdec::Fadc250GenConfig cfg, int nev)
+{
+    fdec::Fadc250Generator gen(cfg);
+    BlockData data;
+    data.words.reserve(static_cast<size_t>(nev)*cfg.nchans*(cfg.nsamples/2 + 8));
+    while (gen.GetNEvents() < static_cast<uint32_t>(nev)) {
+        data.offsets.push_back(data.words.size());
+        gen.GenerateBlock(data.words);
+    }
+    data.nevents = gen.GetNEvents();
+    return data;
+}
+
+// one CODA event per block: event bank (physics) -> ROC bank (crate) -> data bank (uint32)
+void write_evio(const std::string &path, const BlockData &data, int crate, int bank)
+{
+    int handle;
+    char mode[] = "w";
+    if (evOpen(const_cast<char*>(path.c_str()), mode, &handle) != S_SUCCESS) {
+        std::cout << "Cannot open " << path << " for writing." << std::endl;
+        return;
+    }
+
+    std::vector<uint32_t> buf;
+    for (size_t i = 0; i < data.offsets.size(); ++i) {
+        size_t len = data.Size(i);
+        buf.clear();
+        buf.push_back(len + 5);
+        buf.push_back((CODA_PHY1 << 16) | (0x10 << 8) | (data.words[data.offsets[i]] & 0xFF));
+        buf.push_back(len + 3);
+        buf.push_back((crate << 16) | (0x10 << 8));
+        buf.push_back(len + 1);
+        buf.push_back((bank << 16) | (0x01 << 8));
+        buf.insert(buf.end(), data.words.begin() + data.offsets[i], data.words.begin() + data.offsets[i] + len);
+        evWrite(handle, buf.data());
+    }
+    evClose(handle);
+    std::cout << "Wrote " << data.nevents << " events in " << data.offsets.size() << " blocks to " << path << std::endl;
+}
+
+void report(const std::string &mode, const std::string &name, const BenchResult &res)
+{
+    std::cout << std::setw(10) << mode << std::setw(18) << name << std::fixed << std::setprecision(1)
+              << std::setw(14) << res.nwords/res.time*1e-6
+              << std::setw(14) << res.nevents/res.time*1e-3
+              << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,518 @@
+//=============================================================================
+// fdec_check                                                                ||
+// Checks of the FADC250 decoder on crafted and synthetic data, each check  ||
+// prints its failures and the program fails (ctest) if any check fails    ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <string>
+#include "ConfigArgs.h"
+#include "Fadc250Decoder.h"
+#include "Fadc250Unpack.h"
+#include "Fadc250Generator.h"
+#include "Fadc250Rates.h"
+
+
+// the original unpacking of a raw data block, one sample at a time into a growing container
+static uint32_t reference_unpack(const uint32_t *buf, size_t beg, size_t end, std::vector<uint32_t> &raw_data,
+                                 size_t max_samples)
+{
+    uint32_t nwords = 0;
+    for (size_t i = beg + 1; (raw_data.size() < max_samples) && (i < end); ++i, ++nwords) {
+        auto data = buf[i];
+        if ((data & 0x80000000) && nwords > 0) { return nwords; }
+        if (!(data & 0x20000000)) { raw_data.push_back((data >> 16) & 0x1FFF); }
+        if (!(data & 0x2000)) { raw_data.push_back(data & 0x1FFF); }
+    }
+    return nwords;
+}
+
+using UnpackFn = uint32_t (*)(const uint32_t *, size_t, size_t, uint32_t *, size_t, size_t &);
+
+// every unpacking version against the reference on random blocks: odd sample counts, "not valid" samples, a type
+// word in the block, and blocks cut by the end of the buffer
+static size_t check_unpack(int niters)
+{
+    std::vector<std::pair<std::string, UnpackFn>> versions = {
+        {"scalar", [] (const uint32_t *buf, size_t beg, size_t end, uint32_t *out, size_t max_samples,
+                       size_t &nsamples) { return fdec::unpack_words_scalar(buf, beg, end, out, max_samples,
+                                                                            nsamples); }},
+        {"dispatch", fdec::unpack_words},
+    };
+#ifdef FADC250_UNPACK_SIMD
+    if (__builtin_cpu_supports("sse4.1")) { versions.emplace_back("sse4.1", fdec::unpack_words_sse4); }
+    if (__builtin_cpu_supports("avx2")) { versions.emplace_back("avx2", fdec::unpack_words_avx2); }
+#endif
+
+    std::mt19937 rng(12345);
+    std::vector<uint32_t> buf, ref, out;
+    std::vector<size_t> nfailed(versions.size(), 0);
+    for (int it = 0; it < niters; ++it) {
+        size_t nwords = rng() % 160, beg = rng() % 4;
+        buf.assign(beg + 1 + nwords, 0);
+        buf[beg] = 0x80000000 | (4 << 27);
+        for (size_t i = beg + 1; i < buf.size(); ++i) { buf[i] = rng() & 0x1FFF1FFF; }
+
+        switch (rng() % 4) {
+        // a type word ends the block
+        case 1: if (nwords) { buf[beg + 1 + rng() % nwords] |= 0x80000000; } break;
+        // "not valid" samples
+        case 2: if (nwords) { buf[beg + 1 + rng() % nwords] |= (rng() & 1) ? 0x20000000 : 0x2000; } break;
+        // the first word is a type word, it is taken as data
+        case 3: if (nwords) { buf[beg + 1] |= 0x80000000; } break;
+        default: break;
+        }
+
+        // the maximum number of samples can be odd, and the buffer can end before the block
+        size_t max_samples = rng() % (2*nwords + 10);
+        size_t end = (rng() % 3) ? buf.size() : beg + 1 + rng() % (nwords + 1);
+
+        ref.clear();
+        uint32_t ref_nwords = reference_unpack(buf.data(), beg, end, ref, max_samples);
+        for (size_t k = 0; k < versions.size(); ++k) {
+            size_t nsamples = 0;
+            out.assign(max_samples + 1, 0xFFFFFFFF);
+            uint32_t n = versions[k].second(buf.data(), beg, end, out.data(), max_samples, nsamples);
+            if ((n != ref_nwords) || (nsamples != ref.size()) || !std::equal(ref.begin(), ref.end(), out.begin())) {
+                if (!nfailed[k]) {
+                    std::cout << versions[k].first << ": " << nwords << " words, max samples " << max_samples
+                              << ", end " << end - beg - 1 << ", unpacked " << n << " words " << nsamples
+                              << " samples, expected " << ref_nwords << " words " << ref.size() << " samples"
+                              << std::endl;
+                }
+                nfailed[k]++;
+            }
+        }
+    }
+
+    size_t res = 0;
+    for (size_t k = 0; k < versions.size(); ++k) {
+        std::cout << std::setw(10) << versions[k].first << std::setw(10) << niters << " blocks, "
+                  << nfailed[k] << " different" << std::endl;
+        res += nfailed[k];
+    }
+    return res;
+}
+
+
+#define FADC250_TYPE_WORD(type) (0x80000000 | ((type) << 27))
+
+// a generated block of nev events without its fillers and trailer, so the cases can be built from it
+static std::vector<uint32_t> block_body(fdec::Fadc250GenConfig cfg, uint32_t nev)
+{
+    cfg.block_level = nev;
+    fdec::Fadc250Generator gen(cfg);
+    std::vector<uint32_t> buf, res;
+    gen.GenerateBlock(buf);
+    for (size_t i = 0; i + 1 < buf.size(); ++i) {
+        if (buf[i] != FADC250_TYPE_WORD(fdec::FillerWord)) { res.push_back(buf[i]); }
+    }
+    return res;
+}
+
+// append the block trailer with the word count of the block
+static std::vector<uint32_t> with_trailer(std::vector<uint32_t> buf, int count_diff = 0)
+{
+    uint32_t slot = (buf[0] >> 22) & 0x1F;
+    buf.push_back(FADC250_TYPE_WORD(fdec::BlockTrailer) | (slot << 22) | ((buf.size() + 1 + count_diff) & 0x3FFFFF));
+    return buf;
+}
+
+static bool same_data(const fdec::Fadc250Data &a, const fdec::Fadc250Data &b)
+{
+    if ((a.raw != b.raw) || (a.pulse_raw != b.pulse_raw) || (a.peaks.size() != b.peaks.size())
+        || (a.pulses.size() != b.pulses.size())) {
+        return false;
+    }
+    for (size_t i = 0; i < a.peaks.size(); ++i) {
+        auto &p0 = a.peaks[i], &p1 = b.peaks[i];
+        if ((p0.height != p1.height) || (p0.integral != p1.integral) || (p0.time != p1.time)) { return false; }
+    }
+    for (size_t i = 0; i < a.pulses.size(); ++i) {
+        auto &w0 = a.pulses[i], &w1 = b.pulses[i];
+        if ((w0.number != w1.number) || (w0.first != w1.first) || (w0.offset != w1.offset) || (w0.size != w1.size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same_events(const fdec::Fadc250Event &a, const fdec::Fadc250Event &b)
+{
+    if ((a.number != b.number) || (a.mode != b.mode) || (a.time != b.time) || (a.scalers != b.scalers)
+        || (a.channels.size() != b.channels.size())) {
+        return false;
+    }
+    for (size_t i = 0; i < a.channels.size(); ++i) {
+        if (!same_data(a.channels[i], b.channels[i])) { return false; }
+    }
+    return true;
+}
+
+// the data modes of the generator for the checks on synthetic data
+static const std::vector<std::pair<std::string, uint32_t>> gen_modes = {
+    {"window", fdec::kGenWindowRaw},
+    {"pulse", fdec::kGenPulseIntegralTime},
+    {"pulse_raw", fdec::kGenPulseRaw | fdec::kGenPulseIntegralTime},
+    {"mixed", fdec::kGenWindowRaw | fdec::kGenPulseIntegralTime | fdec::kGenPulseRaw},
+};
+
+// decoding errors of DecodeBlock: the decoded events and the error counts of each case are known
+static size_t check_block_errors()
+{
+    fdec::Fadc250GenConfig cfg;
+    cfg.nchans = 4;
+    cfg.nsamples = 20;
+    auto body = block_body(cfg, 2);
+    // the header of the second event
+    size_t second = 0;
+    for (size_t i = 1, n = 0; (i < body.size()) && !second; ++i) {
+        if (((body[i] >> 27) == (0x10 | fdec::EventHeader)) && (++n == 2)) { second = i; }
+    }
+
+    auto set_nevents = [] (std::vector<uint32_t> buf, uint32_t nev) {
+        buf[0] = (buf[0] & ~0xFFu) | nev;
+        return buf;
+    };
+    auto fillers = body;
+    uint32_t filler = FADC250_TYPE_WORD(fdec::FillerWord);
+    fillers.insert(fillers.end(), {filler, filler});
+    fillers.insert(fillers.begin() + second, {filler, filler});
+    fillers.insert(fillers.begin() + 1, filler);
+
+    struct Case {
+        std::string name;
+        std::vector<uint32_t> buf;
+        size_t nevents;
+        std::vector<std::pair<fdec::DecodeError, uint64_t>> errors;
+    };
+    const std::vector<Case> cases = {
+        {"good block", with_trailer(body), 2, {}},
+        {"trailer count", with_trailer(body, 2), 2, {{fdec::DecodeError::TrailerWordCount, 1}}},
+        {"missing trailer", body, 2, {{fdec::DecodeError::MissingTrailer, 1}}},
+        {"too many events", with_trailer(set_nevents(body, 1)), 1, {{fdec::DecodeError::TooManyEvents, 1}}},
+        {"too few events", with_trailer(set_nevents(body, 3)), 2, {{fdec::DecodeError::EventCountMismatch, 1}}},
+        {"fillers", with_trailer(fillers), 2, {}},
+    };
+
+    fdec::Fadc250Decoder decoder;
+    std::vector<fdec::Fadc250Event> good, events;
+    decoder.DecodeBlock(good, cases[0].buf.data(), cases[0].buf.size());
+
+    size_t nfailed = 0;
+    for (auto &c : cases) {
+        decoder.ResetStats();
+        size_t nev = decoder.DecodeBlock(events, c.buf.data(), c.buf.size());
+        bool ok = (nev == c.nevents);
+        for (size_t i = 0; ok && (i < nev); ++i) { ok = same_events(events[i], good[i]); }
+        for (int i = 0; i < static_cast<int>(fdec::DecodeError::Max); ++i) {
+            auto err = static_cast<fdec::DecodeError>(i);
+            uint64_t expected = 0;
+            for (auto &e : c.errors) { if (e.first == err) { expected = e.second; } }
+            ok = ok && (decoder.GetStats().Count(err) == expected);
+        }
+        std::cout << std::setw(20) << c.name << std::setw(6) << nev << " events, " << decoder.GetStats().Total()
+                  << " errors" << (ok ? "" : "  <- unexpected") << std::endl;
+        if (!ok) {
+            decoder.PrintStats();
+            nfailed++;
+        }
+    }
+    return nfailed;
+}
+
+
+// pulse raw data (mode 6): the pulse windows of a pulse-raw-only decoding against the window raw samples of the same
+// generated waveforms (the generator draws the same waveforms for every data mode), and the windows of the channels
+// beyond the event channels are counted as errors instead of being written
+static size_t check_pulse_raw(int nev)
+{
+    fdec::Fadc250GenConfig cfg;
+    cfg.block_level = 4;
+    cfg.pulse_prob = 0.8;
+    cfg.pileup_prob = 0.3;
+    cfg.mode = fdec::kGenWindowRaw | fdec::kGenPulseRaw;
+    fdec::Fadc250Generator gen_window(cfg);
+    cfg.mode = fdec::kGenPulseRaw;
+    fdec::Fadc250Generator gen_pulse(cfg);
+
+    const size_t nchans_small = 8;
+    fdec::Fadc250Decoder dec_window, dec_pulse, dec_small;
+    std::vector<fdec::Fadc250Event> windows, pulses, small;
+    std::vector<uint32_t> buf;
+    uint64_t nwindows = 0, nfailed = 0, nbeyond = 0;
+    while (gen_pulse.GetNEvents() < static_cast<uint32_t>(nev)) {
+        buf.clear();
+        gen_window.GenerateBlock(buf);
+        size_t n = dec_window.DecodeBlock(windows, buf.data(), buf.size());
+
+        buf.clear();
+        gen_pulse.GenerateBlock(buf);
+        dec_pulse.DecodeBlock(pulses, buf.data(), buf.size());
+        dec_small.DecodeBlock(small, buf.data(), buf.size(), nchans_small);
+        for (auto word : buf) {
+            nbeyond += ((word >> 27) == (0x10 | fdec::PulseRawData)) && (((word >> 23) & 0xF) >= nchans_small);
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t ch = 0; ch < pulses[i].channels.size(); ++ch) {
+                auto &raw = windows[i].channels[ch].raw;
+                auto &data = pulses[i].channels[ch];
+                bool ok = data.raw.empty() && (data.pulses.size() == windows[i].channels[ch].pulses.size());
+                for (size_t k = 0; ok && (k < data.pulses.size()); ++k) {
+                    auto &p = data.pulses[k];
+                    ok = (p.number == k) && (p.first + p.size <= raw.size())
+                         && std::equal(raw.begin() + p.first, raw.begin() + p.first + p.size,
+                                       data.pulse_raw.begin() + p.offset);
+                }
+                if (ch < nchans_small) {
+                    ok = ok && (small[i].channels[ch].pulses.size() == data.pulses.size())
+                         && (small[i].channels[ch].pulse_raw == data.pulse_raw);
+                }
+                nwindows += data.pulses.size();
+                nfailed += !ok;
+            }
+        }
+    }
+
+    uint64_t nbad = dec_small.GetStats().Count(fdec::DecodeError::BadChannel);
+    std::cout << std::setw(10) << gen_pulse.GetNEvents() << " events, " << nwindows << " pulse windows, "
+              << nfailed << " different channels, " << nbad << "/" << nbeyond << " windows beyond "
+              << nchans_small << " channels" << std::endl;
+    if (!nwindows || (dec_pulse.GetStats().Total() + dec_window.GetStats().Total())) {
+        dec_pulse.PrintStats();
+        dec_window.PrintStats();
+        nfailed++;
+    }
+    if ((nbad != nbeyond) || (nbad != dec_small.GetStats().Total())) {
+        dec_small.PrintStats();
+        nfailed++;
+    }
+    return nfailed;
+}
+
+
+// trigger time words (bits 23-0 first, then bits 47-24) and scaler counters with known values, the decoded times and
+// the rates are compared with the expected ones
+static size_t check_rates()
+{
+    const uint32_t slot = 3, nev = 10, interval = 25000;
+    // the low 24 bits cross a carry between the first two events, the counter of channel 0 wraps at 32 bits
+    const uint64_t time0 = (0x12345ULL << 24) | 0xFFF000;
+    const uint32_t scalers[2][2] = {{0xFFFFFE00, 100}, {0xFFFFFE00 + 1000, 112}};
+
+    std::vector<uint32_t> buf = {FADC250_TYPE_WORD(fdec::BlockHeader) | (slot << 22) | nev};
+    for (uint32_t k = 0; k < nev; ++k) {
+        uint64_t time = time0 + k*interval;
+        buf.push_back(FADC250_TYPE_WORD(fdec::EventHeader) | (slot << 22) | k);
+        buf.push_back(FADC250_TYPE_WORD(fdec::TriggerTime) | (time & 0xFFFFFF));
+        buf.push_back((time >> 24) & 0xFFFFFF);
+        if ((k == 0) || (k == nev - 1)) {
+            auto &counts = scalers[k ? 1 : 0];
+            buf.insert(buf.end(), {FADC250_TYPE_WORD(fdec::Scaler) | 2, counts[0], counts[1]});
+        }
+    }
+    buf = with_trailer(buf);
+
+    fdec::Fadc250Decoder decoder;
+    fdec::Fadc250Rates rates(4., 1);
+    std::vector<fdec::Fadc250Event> events;
+    size_t n = decoder.DecodeBlock(events, buf.data(), buf.size());
+    size_t nfailed = (n != nev) + decoder.GetStats().Total();
+    for (size_t k = 0; k < n; ++k) {
+        nfailed += (events[k].time != time0 + k*interval);
+        rates.Feed(events[k]);
+    }
+
+    auto close = [] (double val, double ref) { return std::abs(val - ref) <= 1e-9*std::abs(ref); };
+    double elapsed = (nev - 1)*interval*4e-9;
+    nfailed += !close(rates.GetElapsed(), elapsed);
+    nfailed += !close(rates.GetEventRate(), (nev - 1)/elapsed);
+    nfailed += (rates.GetCounts(0) != 1000) || (rates.GetCounts(1) != 12);
+    nfailed += !close(rates.GetScalerTime(), elapsed);
+    nfailed += !close(rates.GetRate(0), 1000./elapsed);
+    nfailed += !close(rates.GetLivetime(), (nev - 1)/12.);
+
+    // the generator writes the same word order, its interval here is above the low 24 bits
+    fdec::Fadc250GenConfig cfg;
+    cfg.nchans = 1;
+    cfg.nsamples = 10;
+    cfg.trigger_interval = 0x01234567;
+    fdec::Fadc250Generator gen(cfg);
+    for (uint32_t k = 0; k < nev; ++k) {
+        buf.clear();
+        gen.GenerateBlock(buf);
+        decoder.DecodeBlock(events, buf.data(), buf.size());
+        nfailed += (events[0].time != (k + 1)*static_cast<uint64_t>(cfg.trigger_interval));
+    }
+
+    rates.PrintSummary();
+    if (nfailed) {
+        std::cout << "Expected elapsed " << elapsed << " s, rate " << (nev - 1)/elapsed << " Hz, scaler 0 rate "
+                  << 1000./elapsed << " Hz, livetime " << (nev - 1)/12.*100. << "%" << std::endl;
+    }
+    return nfailed;
+}
+
+
+// the structure-of-arrays events against the per-channel events from the same blocks, through ToEvent
+static size_t check_flat(int nev)
+{
+    size_t nfailed = 0;
+    for (auto &mode : gen_modes) {
+        for (uint32_t block_level : {1, 8}) {
+            fdec::Fadc250GenConfig cfg;
+            cfg.mode = mode.second;
+            cfg.block_level = block_level;
+            fdec::Fadc250Generator gen(cfg);
+
+            fdec::Fadc250Decoder decoder, flat_decoder;
+            std::vector<fdec::Fadc250Event> events;
+            std::vector<fdec::Fadc250FlatEvent> flat_events;
+            fdec::Fadc250Event converted;
+            std::vector<uint32_t> buf;
+            size_t ndiff = 0;
+            while (gen.GetNEvents() < static_cast<uint32_t>(nev)) {
+                buf.clear();
+                gen.GenerateBlock(buf);
+                size_t n = decoder.DecodeBlock(events, buf.data(), buf.size());
+                size_t nflat = flat_decoder.DecodeBlock(flat_events, buf.data(), buf.size());
+                ndiff += (n != nflat);
+                for (size_t i = 0; i < std::min(n, nflat); ++i) {
+                    flat_events[i].ToEvent(converted);
+                    ndiff += !same_events(events[i], converted);
+                }
+            }
+            std::cout << std::setw(10) << mode.first << std::setw(4) << block_level << std::setw(8)
+                      << gen.GetNEvents() << " events, " << ndiff << " different" << std::endl;
+            nfailed += ndiff + decoder.GetStats().Total() + flat_decoder.GetStats().Total();
+        }
+    }
+    return nfailed;
+}
+
+
+// decoding with a channel mask against the full decoding with the masked channels cleared, for both event layouts
+static size_t check_mask(int nev)
+{
+    const std::vector<uint32_t> masks = {0x0000, 0x0001, 0x8000, 0x5A5A, 0x00FF, 0xFFFE};
+    size_t nfailed = 0;
+    for (auto &mode : gen_modes) {
+        fdec::Fadc250GenConfig cfg;
+        cfg.mode = mode.second;
+        cfg.block_level = 4;
+        cfg.pulse_prob = 0.6;
+        fdec::Fadc250Generator gen(cfg);
+        std::vector<std::vector<uint32_t>> blocks;
+        while (gen.GetNEvents() < static_cast<uint32_t>(nev)) {
+            blocks.emplace_back();
+            gen.GenerateBlock(blocks.back());
+        }
+
+        for (auto mask : masks) {
+            fdec::Fadc250Decoder full, masked, masked_flat;
+            masked.SetChannelMask(mask);
+            masked_flat.SetChannelMask(mask);
+            std::vector<fdec::Fadc250Event> ref_events, events;
+            std::vector<fdec::Fadc250FlatEvent> flat_events;
+            fdec::Fadc250Event converted;
+            size_t ndiff = 0;
+            for (auto &buf : blocks) {
+                size_t n = full.DecodeBlock(ref_events, buf.data(), buf.size());
+                ndiff += (masked.DecodeBlock(events, buf.data(), buf.size()) != n);
+                ndiff += (masked_flat.DecodeBlock(flat_events, buf.data(), buf.size()) != n);
+                for (size_t i = 0; i < n; ++i) {
+                    auto &ref = ref_events[i];
+                    for (uint32_t ch = 0; ch < ref.channels.size(); ++ch) {
+                        if (!(mask & (1u << ch))) { ref.channels[ch].Clear(); }
+                    }
+                    flat_events[i].ToEvent(converted);
+                    ndiff += !same_events(ref, events[i]) + !same_events(ref, converted);
+                }
+            }
+            std::cout << std::setw(10) << mode.first << "  mask 0x" << std::hex << std::setw(4) << std::setfill('0')
+                      << mask << std::dec << std::setfill(' ') << std::setw(8) << gen.GetNEvents() << " events, "
+                      << ndiff << " different" << std::endl;
+            nfailed += ndiff + full.GetStats().Total() + masked.GetStats().Total() + masked_flat.GetStats().Total();
+        }
+    }
+    return nfailed;
+}
+
+
+// a data bank split into slot blocks, a scaler counter that looks like a block trailer stays in its block
+static size_t check_split_blocks()
+{
+    fdec::Fadc250GenConfig cfg;
+    cfg.nchans = 2;
+    cfg.nsamples = 10;
+    std::vector<uint32_t> block3 = block_body(cfg, 1);
+    block3.insert(block3.end(), {FADC250_TYPE_WORD(fdec::Scaler) | 2, FADC250_TYPE_WORD(fdec::BlockTrailer) | 5, 7});
+    block3 = with_trailer(block3);
+    cfg.slot = 4;
+    std::vector<uint32_t> block4 = with_trailer(block_body(cfg, 1));
+
+    std::vector<uint32_t> bank = block3;
+    bank.insert(bank.end(), block4.begin(), block4.end());
+    std::vector<std::pair<uint32_t, size_t>> blocks;
+    size_t n = fdec::Fadc250Decoder::SplitBlocks(bank.data(), bank.size(),
+                                                 [&] (uint32_t slot, const uint32_t *, size_t len) {
+        blocks.emplace_back(slot, len);
+    });
+
+    std::vector<std::pair<uint32_t, size_t>> expected = {{3, block3.size()}, {4, block4.size()}};
+    for (auto &b : blocks) {
+        std::cout << "slot " << b.first << ", " << b.second << " words" << std::endl;
+    }
+    return ((n != expected.size()) || (blocks != expected)) ? 1 : 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddArgs<std::string>({"-c", "--check"}, "check",
+            "the check to run (unpack, block_errors, pulse_raw, rates, flat, mask, split_blocks) or all",
+            "all");
+    arg_parser.AddArg<int>("-n", "niters",
+            "number of random blocks for the unpacking check", 200000);
+    arg_parser.AddArg<int>("-e", "nev",
+            "number of generated events for the checks on synthetic data", 2000);
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    const std::vector<std::pair<std::string, std::function<size_t()>>> checks = {
+        {"unpack", [&] () { return check_unpack(args["niters"].Int()); }},
+        {"block_errors", check_block_errors},
+        {"pulse_raw", [&] () { return check_pulse_raw(args["nev"].Int()); }},
+        {"rates", check_rates},
+        {"flat", [&] () { return check_flat(args["nev"].Int()); }},
+        {"mask", [&] () { return check_mask(args["nev"].Int()); }},
+        {"split_blocks", check_split_blocks},
+    };
+
+    std::string name = args["check"].String();
+    size_t nfailed = 0, nrun = 0;
+    for (auto &check : checks) {
+        if ((name != "all") && (name != check.first)) { continue; }
+        std::cout << "--- " << check.first << std::endl;
+        size_t n = check.second();
+        if (n) {
+            std::cout << "FAILED: " << check.first << ", " << n << " failures." << std::endl;
+        }
+        nfailed += n;
+        nrun++;
+    }
+
+    if (!nrun) {
+        std::cout << "Unknown check \"" << name << "\"." << std::endl;
+        return 1;
+    }
+    return nfailed ? 1 : 0;
+}
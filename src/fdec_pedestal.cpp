@@ -0,0 +1,159 @@
+//=============================================================================
+// fdec_pedestal                                                             ||
+// Per-channel pedestal database (fdec::PedestalDB) from FADC250 data, and   ||
+// a check of the fixed-pedestal analysis against the pedestal search        ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <string>
+#include "EvChannel.h"
+#include "ConfigArgs.h"
+#include "Fadc250Decoder.h"
+#include "WfAnalyzer.h"
+#include "PedestalDB.h"
+#include "scan_blocks.h"
+
+using clk = std::chrono::steady_clock;
+
+// averages of the analyzed pedestals of a channel
+struct PedSum
+{
+    uint64_t n = 0;
+    double mean = 0., err = 0.;
+};
+
+struct FixedPedReport
+{
+    uint64_t nwaveforms = 0, nfixed = 0, nmissing = 0, nmismatch = 0;
+    double max_shift = 0., time_search = 0., time_fixed = 0.;
+
+    void Print(std::ostream &os) const;
+};
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddPositional("raw_data",
+            "raw data in evio format");
+    arg_parser.AddArgs<std::string>({"-o", "--output"}, "output",
+            "output pedestal file", "pedestals.dat");
+    arg_parser.AddArgs<std::string>({"-c", "--check"}, "check",
+            "check the fixed-pedestal analysis with this pedestal file instead of making one", "");
+    arg_parser.AddArg<int>("-n", "nev",
+            "number of events to process (< 0 means all)", -1);
+    arg_parser.AddArg<int>("-r", "res",
+            "resolution for waveform analysis", 3);
+    arg_parser.AddArg<double>("-t", "thres",
+            "peak threshold for waveform analysis", 20.0);
+    arg_parser.AddArg<int>("-p", "npeds",
+            "sample window width for pedestal searching", 8);
+    arg_parser.AddArg<double>("-f", "flat",
+            "flatness requirement for pedestal searching", 1.0);
+    arg_parser.AddArg<double>("-s", "shift",
+            "tolerated baseline shift (adc counts) for the fixed pedestal", 2.0);
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    evc::EvChannel evchan;
+    if (evchan.Open(args["raw_data"].String()) != evc::status::success) {
+        std::cout << "Cannot open evchannel at " << args["raw_data"].String() << std::endl;
+        return -1;
+    }
+
+    fdec::Analyzer ana(args["res"].Int(), args["thres"].Double(), args["npeds"].Int(), args["flat"].Double());
+    ana.SetPedShift(args["shift"].Double());
+    fdec::AnalyzerWorkspace ws;
+    fdec::Fadc250Decoder decoder;
+    std::vector<fdec::Fadc250Event> events;
+    int nev = args["nev"].Int();
+
+    // make the database from the pedestal search
+    std::string check_path = args["check"].String();
+    if (check_path.empty()) {
+        std::map<std::tuple<uint32_t, uint32_t, uint32_t>, PedSum> sums;
+        scan_blocks(evchan, decoder, events, nev, [&] (uint32_t crate, uint32_t slot, fdec::Fadc250Event &ev) {
+            for (size_t ch = 0; ch < ev.channels.size(); ++ch) {
+                auto &data = ev.channels[ch];
+                if (data.raw.empty()) { continue; }
+                ana.Analyze(data, ws);
+                auto &sum = sums[std::make_tuple(crate, slot, static_cast<uint32_t>(ch))];
+                sum.n++;
+                sum.mean += data.ped.mean;
+                sum.err += data.ped.err;
+            }
+        });
+        evchan.Close();
+
+        fdec::PedestalDB db;
+        for (auto &it : sums) {
+            auto &sum = it.second;
+            db.Set(std::get<0>(it.first), std::get<1>(it.first), std::get<2>(it.first),
+                   fdec::Pedestal(sum.mean/sum.n, sum.err/sum.n));
+        }
+        db.Print(std::cout);
+        if (db.Save(args["output"].String())) {
+            std::cout << "Saved " << db.Size() << " channels to \"" << args["output"].String() << "\"." << std::endl;
+        }
+        return 0;
+    }
+
+    // compare the fixed-pedestal analysis with the pedestal search
+    fdec::PedestalDB db;
+    if (!db.Load(check_path)) {
+        return -1;
+    }
+
+    FixedPedReport report;
+    fdec::Fadc250Data fixed;
+    scan_blocks(evchan, decoder, events, nev, [&] (uint32_t crate, uint32_t slot, fdec::Fadc250Event &ev) {
+        for (size_t ch = 0; ch < ev.channels.size(); ++ch) {
+            auto &data = ev.channels[ch];
+            if (data.raw.empty()) { continue; }
+            report.nwaveforms++;
+            auto ped = db.Get(crate, slot, ch);
+            if (!ped) {
+                report.nmissing++;
+                continue;
+            }
+            fixed.raw = data.raw;
+
+            auto t0 = clk::now();
+            ana.Analyze(data, ws);
+            auto t1 = clk::now();
+            report.nfixed += ana.Analyze(fixed, *ped, ws);
+            auto t2 = clk::now();
+            report.time_search += std::chrono::duration<double>(t1 - t0).count();
+            report.time_fixed += std::chrono::duration<double>(t2 - t1).count();
+
+            report.max_shift = std::max(report.max_shift, std::abs(fixed.ped.mean - data.ped.mean));
+            bool match = (data.peaks.size() == fixed.peaks.size());
+            for (size_t i = 0; match && (i < data.peaks.size()); ++i) {
+                match = (data.peaks[i].pos == fixed.peaks[i].pos);
+            }
+            report.nmismatch += !match;
+        }
+    });
+    evchan.Close();
+
+    report.Print(std::cout);
+    return 0;
+}
+
+void FixedPedReport::Print(std::ostream &os) const
+{
+    uint64_t n = nwaveforms - nmissing;
+    os << "Waveforms: " << nwaveforms << ", not in the database: " << nmissing << std::endl;
+    if (!n) { return; }
+    os << "Fixed pedestal used: " << nfixed << " (" << std::setprecision(4) << 100.*nfixed/n << "%)"
+       << ", searched: " << n - nfixed << std::endl;
+    os << "Max pedestal difference to the search: " << max_shift
+       << ", waveforms with different peaks: " << nmismatch << std::endl;
+    os << "Analysis time per waveform (us), search: " << time_search/n*1e6
+       << ", fixed pedestal: " << time_fixed/n*1e6 << std::endl;
+}
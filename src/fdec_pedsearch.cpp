@@ -0,0 +1,160 @@
+//=============================================================================
+// fdec_pedsearch                                                            ||
+// The sliding-window pedestal search against the original one (every      ||
+// window computed from scratch), and the batch analysis against Analyze,  ||
+// on synthetic FADC250 waveforms, the results must be identical           ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include "ConfigArgs.h"
+#include "Fadc250Decoder.h"
+#include "Fadc250Generator.h"
+#include "WfAnalyzer.h"
+
+
+// the original pedestal search of Analyzer::FindPedestal, returns false if there is no flat window
+static bool reference_pedestal(const std::vector<double> &buffer, size_t npeds, double ped_flat, uint32_t overflow,
+                               fdec::Pedestal &ped)
+{
+    int ntrails = std::max(npeds, buffer.size()/12);
+    double max_mean = overflow*0.95;
+    bool find_baseline = false;
+
+    ped.mean = max_mean;
+    for (size_t i = 0; i <= buffer.size() - ntrails; ++i) {
+        double mean = 0., err = 100.*ped_flat;
+        fdec::_calc_mean_err(mean, err, &buffer[i], ntrails);
+        if(err < ped_flat && mean < max_mean) {
+            find_baseline = true;
+            if (mean < ped.mean) { ped.mean = mean; ped.err = err; }
+        }
+    }
+    return find_baseline;
+}
+
+// equal-length waveforms in one array
+struct Waveforms
+{
+    size_t nsamples = 0;
+    std::vector<uint32_t> samples;
+
+    size_t Size() const { return nsamples ? samples.size()/nsamples : 0; }
+    const uint32_t *Get(size_t i) const { return samples.data() + i*nsamples; }
+};
+
+static Waveforms generate(fdec::Fadc250GenConfig cfg, int nev);
+
+// batch analysis against the analysis of each waveform, returns the number of different waveforms
+template<typename F>
+size_t compare_batch(const fdec::AnalyzerT<F> &ana, const Waveforms &wfs)
+{
+    typename fdec::AnalyzerT<F>::Workspace ws;
+    fdec::WfBatchResult res;
+    ana.AnalyzeBatch(wfs.samples.data(), wfs.Size(), wfs.nsamples, res, ws);
+
+    size_t ndiff = 0;
+    fdec::Fadc250Data data;
+    for (size_t i = 0; i < wfs.Size(); ++i) {
+        data.raw.assign(wfs.Get(i), wfs.Get(i) + wfs.nsamples);
+        ana.Analyze(data, ws);
+        bool same = (data.ped.mean == res.peds[i].mean) && (data.ped.err == res.peds[i].err)
+                    && (data.peaks.size() == res.npeaks[i]);
+        for (size_t j = 0; same && (j < data.peaks.size()); ++j) {
+            const auto &p0 = data.peaks[j], &p1 = res.Peaks(i)[j];
+            same = (p0.pos == p1.pos) && (p0.height == p1.height) && (p0.integral == p1.integral);
+        }
+        ndiff += !same;
+    }
+    return ndiff;
+}
+
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddArg<int>("-n", "nev",
+            "number of events (16 waveforms each) per configuration", 1000);
+    arg_parser.AddArg<int>("-r", "res",
+            "resolution for waveform analysis", 3);
+    arg_parser.AddArg<double>("-t", "thres",
+            "peak threshold for waveform analysis", 20.0);
+    arg_parser.AddArg<int>("-p", "npeds",
+            "sample window width for pedestal searching", 8);
+    arg_parser.AddArg<double>("-f", "flat",
+            "flatness requirement for pedestal searching", 1.0);
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    fdec::Analyzer ana(args["res"].Int(), args["thres"].Double(), args["npeds"].Int(), args["flat"].Double());
+    fdec::AnalyzerF anaf(args["res"].Int(), args["thres"].Double(), args["npeds"].Int(), args["flat"].Double());
+    fdec::Analyzer::Workspace ws;
+
+    // noise 0 makes the pedestal windows tie exactly, large noise leaves no flat window (background estimation)
+    size_t nfailed = 0;
+    std::cout << std::setw(10) << "samples" << std::setw(8) << "noise" << std::setw(12) << "waveforms"
+              << std::setw(12) << "no window" << std::setw(12) << "search" << std::setw(12) << "batch"
+              << std::setw(14) << "batch float" << std::endl;
+    for (uint32_t nsamples : {30, 100, 250}) {
+        for (double noise : {0., 0.5, 2., 5.}) {
+            fdec::Fadc250GenConfig cfg;
+            cfg.mode = fdec::kGenWindowRaw;
+            cfg.nsamples = nsamples;
+            cfg.noise = noise;
+            cfg.pileup_prob = 0.2;
+            auto wfs = generate(cfg, args["nev"].Int());
+
+            size_t nbackground = 0, ndiff = 0;
+            fdec::Pedestal ref;
+            for (size_t i = 0; i < wfs.Size(); ++i) {
+                ana.SmoothSpectrum(wfs.Get(i), wfs.nsamples, ana.GetResolution(), ws.buffer, ws.input);
+                auto ped = ana.FindPedestal(ws.buffer, ws.candidates, ws.ybuf, ws.work);
+                if ((ws.buffer.size() < ana.GetNSamplesPed()) ||
+                    !reference_pedestal(ws.buffer, ana.GetNSamplesPed(), ana.GetPedFlatness(),
+                                        ana.GetOverflowValue(), ref)) {
+                    nbackground++;
+                    continue;
+                }
+                ndiff += (ped.mean != ref.mean) || (ped.err != ref.err);
+            }
+            size_t nbatch = compare_batch(ana, wfs), nbatchf = compare_batch(anaf, wfs);
+
+            std::cout << std::setw(10) << nsamples << std::setw(8) << noise << std::setw(12) << wfs.Size()
+                      << std::setw(12) << nbackground << std::setw(12) << ndiff << std::setw(12) << nbatch
+                      << std::setw(14) << nbatchf << std::endl;
+            nfailed += ndiff + nbatch + nbatchf;
+        }
+    }
+
+    if (nfailed) {
+        std::cout << "FAILED: " << nfailed << " waveforms have different pedestals or peaks." << std::endl;
+        return 1;
+    }
+    std::cout << "All pedestals and peaks are identical." << std::endl;
+    return 0;
+}
+
+Waveforms generate(fdec::Fadc250GenConfig cfg, int nev)
+{
+    fdec::Fadc250Generator gen(cfg);
+    fdec::Fadc250Decoder decoder;
+    std::vector<uint32_t> buf;
+    std::vector<fdec::Fadc250Event> events;
+    Waveforms wfs;
+    wfs.nsamples = cfg.nsamples;
+    while (gen.GetNEvents() < static_cast<uint32_t>(nev)) {
+        buf.clear();
+        gen.GenerateBlock(buf);
+        size_t n = decoder.DecodeBlock(events, buf.data(), buf.size());
+        for (size_t i = 0; i < n; ++i) {
+            for (auto &ch : events[i].channels) {
+                if (ch.raw.size() != cfg.nsamples) { continue; }
+                wfs.samples.insert(wfs.samples.end(), ch.raw.begin(), ch.raw.end());
+            }
+        }
+    }
+    return wfs;
+}
@@ -0,0 +1,164 @@
+//=============================================================================
+// fdec_template                                                             ||
+// Per-channel pulse templates (fdec::PulseTemplateDB) from FADC250 data,    ||
+// and a check of the template fit timing                                   ||
+//=============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <string>
+#include "EvChannel.h"
+#include "ConfigArgs.h"
+#include "Fadc250Decoder.h"
+#include "WfAnalyzer.h"
+#include "PulseTemplate.h"
+#include "scan_blocks.h"
+
+using clk = std::chrono::steady_clock;
+using ChannelKey = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+
+int main(int argc, char *argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddPositional("raw_data",
+            "raw data in evio format");
+    arg_parser.AddArgs<std::string>({"-o", "--output"}, "output",
+            "output template file", "templates.dat");
+    arg_parser.AddArgs<std::string>({"-c", "--check"}, "check",
+            "check the template fit with this template file instead of making one", "");
+    arg_parser.AddArg<int>("-n", "nev",
+            "number of events to process (< 0 means all)", -1);
+    arg_parser.AddArg<int>("-r", "res",
+            "resolution for waveform analysis", 3);
+    arg_parser.AddArg<double>("-t", "thres",
+            "peak threshold for waveform analysis", 20.0);
+    arg_parser.AddArg<int>("-p", "npeds",
+            "sample window width for pedestal searching", 8);
+    arg_parser.AddArg<double>("-f", "flat",
+            "flatness requirement for pedestal searching", 1.0);
+    arg_parser.AddArgs<double>({"--min-height"}, "min_height",
+            "minimum peak height (adc counts) of the pulses for the templates", 100.);
+    arg_parser.AddArgs<int>({"--min-pulses"}, "min_pulses",
+            "minimum number of pulses for the template of a channel", 200);
+    arg_parser.AddArgs<int>({"--nsub"}, "nsub",
+            "template points per sample", 32);
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    std::string path = args["raw_data"].String();
+    evc::EvChannel evchan;
+    if (evchan.Open(path) != evc::status::success) {
+        std::cout << "Cannot open evchannel at " << path << std::endl;
+        return -1;
+    }
+
+    fdec::Analyzer ana(args["res"].Int(), args["thres"].Double(), args["npeds"].Int(), args["flat"].Double());
+    fdec::AnalyzerWorkspace ws;
+    fdec::Fadc250Decoder decoder;
+    std::vector<fdec::Fadc250Event> events;
+    int nev = args["nev"].Int();
+
+    // check the fit with the templates
+    std::string check_path = args["check"].String();
+    if (!check_path.empty()) {
+        fdec::PulseTemplateDB db;
+        if (!db.Load(check_path)) {
+            return -1;
+        }
+        uint64_t nwaveforms = 0, npeaks = 0, nfitted = 0;
+        double time_analysis = 0., time_fit = 0.;
+        scan_blocks(evchan, decoder, events, nev, [&] (uint32_t crate, uint32_t slot, fdec::Fadc250Event &ev) {
+            for (size_t ch = 0; ch < ev.channels.size(); ++ch) {
+                auto &data = ev.channels[ch];
+                auto tmpl = db.Get(crate, slot, ch);
+                if (data.raw.empty() || !tmpl) { continue; }
+                auto t0 = clk::now();
+                ana.Analyze(data, ws);
+                auto t1 = clk::now();
+                nfitted += ana.FitPeaks(data, *tmpl);
+                auto t2 = clk::now();
+                time_analysis += std::chrono::duration<double>(t1 - t0).count();
+                time_fit += std::chrono::duration<double>(t2 - t1).count();
+                nwaveforms++;
+                npeaks += data.peaks.size();
+            }
+        });
+        evchan.Close();
+
+        std::cout << "Waveforms with a template: " << nwaveforms << ", peaks: " << npeaks << ", fitted: " << nfitted
+                  << std::endl;
+        if (nwaveforms) {
+            std::cout << "Time per waveform (us), analysis: " << time_analysis/nwaveforms*1e6
+                      << ", template fit: " << time_fit/nwaveforms*1e6 << std::endl;
+        }
+        return 0;
+    }
+
+    // make the templates, the first pass aligns the pulses by their leading edges and the second one by the fit with
+    // the first templates
+    double min_height = args["min_height"].Double();
+    size_t min_pulses = args["min_pulses"].Int(), nsub = args["nsub"].Int();
+    auto good_pulse = [min_height] (const fdec::Fadc250Data &data) {
+        return (data.peaks.size() == 1) && !data.peaks[0].overflow && (data.peaks[0].height >= min_height);
+    };
+
+    std::map<ChannelKey, fdec::PulseTemplate> first, second;
+    for (int pass = 0; pass < 2; ++pass) {
+        if ((pass > 0) && (evchan.Open(path) != evc::status::success)) {
+            std::cout << "Cannot reopen evchannel at " << path << std::endl;
+            return -1;
+        }
+        scan_blocks(evchan, decoder, events, nev, [&] (uint32_t crate, uint32_t slot, fdec::Fadc250Event &ev) {
+            for (size_t ch = 0; ch < ev.channels.size(); ++ch) {
+                auto &data = ev.channels[ch];
+                if (data.raw.empty()) { continue; }
+                ana.Analyze(data, ws);
+                if (!good_pulse(data)) { continue; }
+
+                auto key = std::make_tuple(crate, slot, static_cast<uint32_t>(ch));
+                auto &peak = data.peaks[0];
+                double amp = peak.height, time;
+                if (pass == 0) {
+                    if (!fdec::PulseTemplate::LeadingEdge(data.raw.data(), data.raw.size(), data.ped.mean, peak.pos,
+                                                          time)) { continue; }
+                    first.emplace(key, fdec::PulseTemplate(4, 12, nsub)).first->second
+                        .Fill(data.raw.data(), data.raw.size(), data.ped.mean, amp, time);
+                } else {
+                    auto it = first.find(key);
+                    if ((it == first.end()) || it->second.Empty() ||
+                        !it->second.Fit(data.raw.data(), data.raw.size(), data.ped.mean, peak.pos, peak.left,
+                                        peak.right, amp, time)) { continue; }
+                    second.emplace(key, fdec::PulseTemplate(4, 12, nsub)).first->second
+                        .Fill(data.raw.data(), data.raw.size(), data.ped.mean, amp, time);
+                }
+            }
+        });
+        evchan.Close();
+
+        for (auto &it : (pass == 0) ? first : second) {
+            if (it.second.GetNPulses() >= min_pulses) { it.second.Finish(); }
+        }
+    }
+
+    fdec::PulseTemplateDB db;
+    std::cout << std::setw(7) << "crate" << std::setw(6) << "slot" << std::setw(9) << "channel"
+              << std::setw(10) << "pulses" << std::endl;
+    for (auto &it : second) {
+        uint32_t crate = std::get<0>(it.first), slot = std::get<1>(it.first), ch = std::get<2>(it.first);
+        std::cout << std::setw(7) << crate << std::setw(6) << slot << std::setw(9) << ch
+                  << std::setw(10) << it.second.GetNPulses() << (it.second.Empty() ? "  (too few pulses)" : "")
+                  << std::endl;
+        if (!it.second.Empty()) { db.Set(crate, slot, ch, it.second); }
+    }
+    if (db.Save(args["output"].String())) {
+        std::cout << "Saved " << db.Size() << " channel templates to \"" << args["output"].String() << "\"."
+                  << std::endl;
+    }
+    return 0;
+}
@@ -8,14 +8,13 @@
 #include "EvChannel.h"
 #include "ConfigArgs.h"
 #include "Fadc250Decoder.h"
-#include "WfAnalyzer.h"
+#include "Fadc250Rates.h"
 #include "read_modules.h"
 
 #define PROGRESS_COUNT 1000
 
 
-void write_raw_data(const std::string &dpath, const std::string &opath, const std::string &mpath, int nev,
-                    int res = 3, double thres = 20, int npeds = 5, double flat = 1.0);
+void write_raw_data(const std::string &dpath, const std::string &opath, const std::string &mpath, int nev);
 
 // event types
 enum EvType {
@@ -40,18 +39,6 @@ int main(int argc, char*argv[])
     arg_parser.AddArgs<std::string>({"-m", "--module"}, "module",
             "json file for module configuration",
             "database/esb_test_modules.json");
-    arg_parser.AddArg<int>("-r", "res",
-            "resolution for waveform analysis",
-            3);
-    arg_parser.AddArg<double>("-t", "thres",
-            "peak threshold for waveform analysis",
-            20.0);
-    arg_parser.AddArg<int>("-p", "npeds",
-            "sample window width for pedestal searching",
-            8);
-    arg_parser.AddArg<double>("-f", "flat",
-            "flatness requirement for pedestal searching",
-            1.0);
 
     auto args = arg_parser.ParseArgs(argc, argv);
 
@@ -63,43 +50,91 @@ int main(int argc, char*argv[])
     write_raw_data(args["raw_data"].String(),
                    args["output"].String(),
                    args["module"].String(),
-                   args["nev"].Int(),
-                   args["res"].Int(),
-                   args["thres"].Double(),
-                   args["npeds"].Int(),
-                   args["flat"].Double());
+                   args["nev"].Int());
     return 0;
 }
 
+// FADC250 module, the events of a block are written to the branches one by one, and they feed the rates of the module
+class Fadc250Module : public ModuleDecoder
+{
+public:
+    Fadc250Module(const Module &m) : ModuleDecoder(m), event(0, 16), nevents(0)
+    {
+        // only decode the mapped channels
+        uint32_t mask = 0;
+        for (auto &ch : module.channels) { mask |= (1u << (ch.id & 0xF)); }
+        decoder.SetChannelMask(mask);
+    }
+
+    void Branch(TTree *tree) override
+    {
+        for (auto &ch : module.channels) {
+            tree->Branch(ch.name.c_str(), &event.channels[ch.id], 32000, 0);
+        }
+    }
+
+    size_t Decode(const uint32_t *buf, size_t len) override
+    {
+        nevents = decoder.DecodeBlock(events, buf, len);
+        return nevents;
+    }
+
+    void SetEvent(size_t i) override
+    {
+        if (i >= nevents) {
+            event.Clear();
+            return;
+        }
+        // swap the channel contents, the branch addresses stay the same
+        auto &ev = events[i];
+        event.number = ev.number;
+        event.mode = ev.mode;
+        event.time = ev.time;
+        std::swap(event.scalers, ev.scalers);
+        for (size_t j = 0; j < event.channels.size() && j < ev.channels.size(); ++j) {
+            std::swap(event.channels[j], ev.channels[j]);
+        }
+        rates.Feed(event);
+    }
+
+    size_t GetNEvents() const override { return nevents; }
+
+    void Clear() override
+    {
+        event.Clear();
+        nevents = 0;
+    }
+
+    void PrintSummary(std::ostream &os) const override
+    {
+        os << "FADC250 crate " << module.crate << ", bank " << module.bank << ", slot " << module.slot << ": ";
+        decoder.PrintStats(os);
+        rates.PrintSummary(os);
+    }
+
+private:
+    fdec::Fadc250Decoder decoder;
+    fdec::Fadc250Rates rates;
+    fdec::Fadc250Event event;
+    std::vector<fdec::Fadc250Event> events;
+    size_t nevents;
+};
+
+static bool fadc250_registered = ModuleRegistry::Instance().Register<Fadc250Module>(kFADC250);
+
 // create an event tree according to modules
-TTree *create_tree(std::vector<Module> &modules, const std::string tname = "EvTree",
+TTree *create_tree(const ModuleDispatcher &dispatcher, const std::string tname = "EvTree",
                    const std::string &ttitle = "Cherenkov Test Events")
 {
     auto tree = new TTree(tname.c_str(), ttitle.c_str());
-    for (auto &m : modules) {
-        switch (m.type) {
-        case kFADC250:
-            {
-                // 16 channels
-                auto event = new fdec::Fadc250Event(0, 16);
-                m.event = static_cast<void*>(event);
-                for (auto &ch : m.channels) {
-                    auto n = ch.name;
-                    tree->Branch(n.c_str(), &event->channels[ch.id], 32000, 0);
-                }
-            }
-            break;
-        default:
-            std::cout << "Unsupported module type " << m.type << std::endl;
-            break;
-        }
+    for (auto &dec : dispatcher.GetDecoders()) {
+        dec->Branch(tree);
     }
     return tree;
 }
 
 // read raw data in evio format, and extract information
-void write_raw_data(const std::string &dpath, const std::string &opath, const std::string &mpath, int nev,
-                    int res, double thres, int npeds, double flat)
+void write_raw_data(const std::string &dpath, const std::string &opath, const std::string &mpath, int nev)
 {
     // read modules
     auto modules = read_modules(mpath);
@@ -118,23 +153,16 @@ void write_raw_data(const std::string &dpath, const std::string &opath, const st
 
     // output
     auto *hfile = new TFile(opath.c_str(), "RECREATE", "MAPMT test results");
-    auto tree = create_tree(modules);
+    ModuleDispatcher dispatcher(modules);
+    auto tree = create_tree(dispatcher);
 
-    fdec::Fadc250Decoder fdecoder;
-    // waveform analyzer
-    fdec::Analyzer analyzer(res, thres, npeds, flat);
     int count = 0;
-    auto &ref = modules.front();
-    std::vector<uint64_t> times;
     while ((evchan.Read() == evc::status::success) && (nev-- != 0)) {
 
         count ++;
-        if (count > 5) { break; }
-        /*
         if((count % PROGRESS_COUNT) == 0) {
             std::cout << "Processed events - " << count << "\r" << std::flush;
         }
-        */
 
         switch(evchan.GetEvHeader().tag) {
         // only want physics events
@@ -150,20 +178,33 @@ void write_raw_data(const std::string &dpath, const std::string &opath, const st
 
         auto banks = evchan.ScanBanks();
 
-        for (auto bank : banks) {
-            std::cout << "start = " << bank.buf_loc
-                      << ", type = " << evc::DataType2str(evc::DataType(bank.type))
-                      << ", length = " << bank.length
-                      << ", tag = " << std::hex << "0x" << bank.tag
-                      << ", num = " << bank.num << std::dec
-                      << std::endl;
+        // dispatch the data banks to the module decoders, crate is from the latest bank of banks (ROC bank)
+        dispatcher.Clear();
+        int crate = -1;
+        auto buf = evchan.GetRawBuffer();
+        for (auto &bank : banks) {
+            switch (bank.type) {
+            case evc::DATA_BANK:
+            case evc::DATA_ALSOBANK:
+                crate = bank.tag;
+                break;
+            case evc::DATA_UINT32:
+            case evc::DATA_UNKNOWN32:
+                dispatcher.DecodeBank(crate, bank.tag, buf + bank.buf_loc + 2, bank.length - 1);
+                break;
+            default:
+                break;
+            }
+        }
+        // one entry per decoded event, a CODA event has block level events of each module
+        for (size_t i = 0; i < dispatcher.GetNEvents(); ++i) {
+            dispatcher.SetEvent(i);
+            tree->Fill();
         }
-
-        // get block level
     }
     std::cout << "Processed events - " << count << std::endl;
-    if (times.size()) {
-        std::cout << "Time difference: " << (times.back() - times.front())*4*1e-9 << "s" << std::endl;
+    for (auto &dec : dispatcher.GetDecoders()) {
+        dec->PrintSummary(std::cout);
     }
 
     evchan.Close();
@@ -3,7 +3,13 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
 #include "ConfigObject.h"
+#include "Fadc250Decoder.h"
 #include "nlohmann/json.hpp"
 
 
@@ -39,8 +45,159 @@ struct Module
     int crate, slot, bank;
     ModuleType type;
     std::vector<Channel> channels;
-    // save for adding data
-    void *event = nullptr;
+};
+
+
+class TTree;
+
+// decoder of a module, it owns the decoded event of the module
+class ModuleDecoder
+{
+public:
+    ModuleDecoder(const Module &m) : module(m) {}
+    virtual ~ModuleDecoder() {}
+
+    // create branches for the module channels
+    virtual void Branch(TTree *tree) = 0;
+    // decode a slot block of the module, returns the number of decoded events (block level)
+    virtual size_t Decode(const uint32_t *buf, size_t len) = 0;
+    // put the i-th decoded event of the block to the branches, they are cleared if there is no such event
+    virtual void SetEvent(size_t i) = 0;
+    virtual size_t GetNEvents() const = 0;
+    virtual void Clear() = 0;
+    virtual void PrintSummary(std::ostream &os = std::cout) const {}
+
+    const Module &GetModule() const { return module; }
+
+protected:
+    Module module;
+};
+
+
+// each module type registers a decoder (with its event type) here
+class ModuleRegistry
+{
+public:
+    typedef std::function<std::unique_ptr<ModuleDecoder>(const Module &)> Factory;
+
+    static ModuleRegistry &Instance()
+    {
+        static ModuleRegistry registry;
+        return registry;
+    }
+
+    template<class Decoder>
+    bool Register(ModuleType type)
+    {
+        factories[type] = [] (const Module &m) { return std::unique_ptr<ModuleDecoder>(new Decoder(m)); };
+        return true;
+    }
+
+    std::unique_ptr<ModuleDecoder> Create(const Module &m) const
+    {
+        if ((m.type < 0) || (m.type >= kMaxModuleType) || !factories[m.type]) {
+            return nullptr;
+        }
+        return factories[m.type](m);
+    }
+
+private:
+    ModuleRegistry() {}
+    Factory factories[kMaxModuleType];
+};
+
+
+// module decoders in a dense (crate, bank, slot) table, crates and banks are re-indexed to the configured ones
+class ModuleDispatcher
+{
+public:
+    static const int nslots = 32;
+
+    ModuleDispatcher(const std::vector<Module> &modules)
+    {
+        int max_crate = -1, max_bank = -1;
+        for (auto &m : modules) {
+            if ((m.crate < 0) || (m.bank < 0) || (m.slot < 0) || (m.slot >= nslots)) {
+                std::cout << "Invalid module address: crate = " << m.crate << ", bank = " << m.bank
+                          << ", slot = " << m.slot << std::endl;
+                continue;
+            }
+            max_crate = std::max(max_crate, m.crate);
+            max_bank = std::max(max_bank, m.bank);
+        }
+        crate_idx.assign(max_crate + 1, -1);
+        bank_idx.assign(max_bank + 1, -1);
+        int ncrates = 0, nbanks = 0;
+        for (auto &m : modules) {
+            if ((m.crate < 0) || (m.bank < 0) || (m.slot < 0) || (m.slot >= nslots)) { continue; }
+            if (crate_idx[m.crate] < 0) { crate_idx[m.crate] = ncrates++; }
+            if (bank_idx[m.bank] < 0) { bank_idx[m.bank] = nbanks++; }
+        }
+        nbank_slots = nbanks*nslots;
+        table.assign(ncrates*nbank_slots, nullptr);
+
+        for (auto &m : modules) {
+            if ((m.crate < 0) || (m.bank < 0) || (m.slot < 0) || (m.slot >= nslots)) { continue; }
+            auto dec = ModuleRegistry::Instance().Create(m);
+            if (!dec) {
+                std::cout << "Unsupported module type " << ModuleType2str(m.type) << std::endl;
+                continue;
+            }
+            auto &entry = table[crate_idx[m.crate]*nbank_slots + bank_idx[m.bank]*nslots + m.slot];
+            if (entry) {
+                std::cout << "Duplicated module: crate = " << m.crate << ", bank = " << m.bank
+                          << ", slot = " << m.slot << std::endl;
+                continue;
+            }
+            entry = dec.get();
+            decoders.emplace_back(std::move(dec));
+        }
+    }
+
+    ModuleDecoder *Get(int crate, int bank, int slot) const
+    {
+        if ((crate < 0) || (crate >= static_cast<int>(crate_idx.size())) || (crate_idx[crate] < 0) ||
+            (bank < 0) || (bank >= static_cast<int>(bank_idx.size())) || (bank_idx[bank] < 0) ||
+            (slot < 0) || (slot >= nslots)) {
+            return nullptr;
+        }
+        return table[crate_idx[crate]*nbank_slots + bank_idx[bank]*nslots + slot];
+    }
+
+    // a data bank has blocks from the slots (block header type 0 with slot in bits 26-22, block trailer type 1)
+    // each block goes to the decoder of its slot, returns the number of decoded blocks
+    size_t DecodeBank(int crate, int bank, const uint32_t *buf, size_t len) const
+    {
+        size_t nblocks = 0;
+        fdec::Fadc250Decoder::SplitBlocks(buf, len, [&] (uint32_t slot, const uint32_t *block, size_t n) {
+            auto dec = Get(crate, bank, slot);
+            if (dec) {
+                dec->Decode(block, n);
+                ++nblocks;
+            }
+        });
+        return nblocks;
+    }
+
+    void Clear() { for (auto &dec : decoders) { dec->Clear(); } }
+
+    // the blocks have several events if the block level is above 1, they are filled to the tree one by one
+    size_t GetNEvents() const
+    {
+        size_t nev = 0;
+        for (auto &dec : decoders) { nev = std::max(nev, dec->GetNEvents()); }
+        return nev;
+    }
+
+    void SetEvent(size_t i) { for (auto &dec : decoders) { dec->SetEvent(i); } }
+
+    const std::vector<std::unique_ptr<ModuleDecoder>> &GetDecoders() const { return decoders; }
+
+private:
+    std::vector<int> crate_idx, bank_idx;
+    int nbank_slots;
+    std::vector<ModuleDecoder*> table;
+    std::vector<std::unique_ptr<ModuleDecoder>> decoders;
 };
 
 
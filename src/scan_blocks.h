@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "EvChannel.h"
+#include "Fadc250Decoder.h"
+
+#define CODA_PRST 0xffd1
+#define CODA_GO 0xffd2
+#define CODA_END 0xffd4
+
+
+// calls func(crate, slot, event) for the events of every slot block, crate is from the latest bank of banks (ROC)
+template<class Func>
+void scan_blocks(evc::EvChannel &evchan, fdec::Fadc250Decoder &decoder, std::vector<fdec::Fadc250Event> &events,
+                 int nev, Func &&func)
+{
+    while ((evchan.Read() == evc::status::success) && (nev-- != 0)) {
+        auto tag = evchan.GetEvHeader().tag;
+        if ((tag == CODA_PRST) || (tag == CODA_GO) || (tag == CODA_END)) {
+            continue;
+        }
+
+        uint32_t crate = 0;
+        auto buf = evchan.GetRawBuffer();
+        for (auto &bank : evchan.ScanBanks()) {
+            if ((bank.type == evc::DATA_BANK) || (bank.type == evc::DATA_ALSOBANK)) {
+                crate = bank.tag;
+                continue;
+            }
+            if ((bank.type != evc::DATA_UINT32) && (bank.type != evc::DATA_UNKNOWN32)) {
+                continue;
+            }
+            // slot blocks of the bank
+            fdec::Fadc250Decoder::SplitBlocks(buf + bank.buf_loc + 2, bank.length - 1,
+                                              [&] (uint32_t slot, const uint32_t *block, size_t len) {
+                size_t n = decoder.DecodeBlock(events, block, len);
+                for (size_t k = 0; k < n; ++k) { func(crate, slot, events[k]); }
+            });
+        }
+    }
+}